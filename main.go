@@ -1,6 +1,7 @@
 package main
 
 import (
+	"compress/gzip"
 	"encoding/json"
 	"fmt"
 	"io/ioutil"
@@ -18,6 +19,7 @@ import (
 	"gopkg.in/yaml.v3"
 	"gorm.io/driver/mysql"
 	"gorm.io/gorm"
+	"gorm.io/gorm/clause"
 )
 
 // 配置结构体
@@ -119,6 +121,56 @@ func (Sample) TableName() string {
 	return "samples"
 }
 
+// SampleChunk 采集端边采集边上传的数据分片，提交后合并进 Sample.Data
+// Session 为采集开始时间，同一 sample_id 重复采集时各次的分片互不覆盖
+type SampleChunk struct {
+	ID        uint   `gorm:"primaryKey"`
+	SampleID  string `gorm:"type:varchar(255);not null;uniqueIndex:idx_sample_session_seq"`
+	Session   string `gorm:"type:varchar(32);not null;default:'';uniqueIndex:idx_sample_session_seq"`
+	Seq       int    `gorm:"not null;uniqueIndex:idx_sample_session_seq"`
+	Payload   []byte `gorm:"type:longblob"`
+	CreatedAt time.Time
+}
+
+// TableName 设置 SampleChunk 表名
+func (SampleChunk) TableName() string {
+	return "sample_chunks"
+}
+
+// chunkData 单个分片中的采集数据
+type chunkData struct {
+	ChannelID []int `json:"channel_id"`
+	IR        []int `json:"ir"`
+	Reds      []int `json:"reds"`
+	Quality   []int `json:"quality,omitempty"` // 每个通道在本分片内最差的信号质量等级，0 无接触 1 较差 2 良好 255 未评估
+}
+
+// chunkQuality 合并后每个分片的信号质量标签，Samples 为该分片的采样点数
+type chunkQuality struct {
+	Samples int   `json:"samples"`
+	Level   []int `json:"level"`
+}
+
+// 查找采样记录并校验 user_uuid，失败时已写好响应
+func findCollectSample(c *gin.Context, sampleID, userUUID string) (*Sample, bool) {
+	var sample Sample
+	if err := DB.Where("sample_id = ?", sampleID).First(&sample).Error; err != nil {
+		if err == gorm.ErrRecordNotFound {
+			// 带 code 的 JSON，采集端据此区分采样记录不存在与接口不存在（gin 的纯文本 404）
+			c.JSON(http.StatusNotFound, gin.H{"error": "采样记录未找到", "code": "sample_not_found"})
+		} else {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "数据库错误"})
+		}
+		return nil, false
+	}
+
+	if sample.UserUUID != userUUID {
+		c.JSON(http.StatusForbidden, gin.H{"error": "sample_id 与 user_uuid 不匹配"})
+		return nil, false
+	}
+	return &sample, true
+}
+
 // 加载配置文件
 func LoadConfig() *Config {
 	config := &Config{}
@@ -194,6 +246,33 @@ func parseDate(dateStr string) (*time.Time, error) {
 	return &parsedDate, nil
 }
 
+// 解压请求体：支持 Content-Encoding: gzip，其它编码返回 415，客户端会退回不压缩
+func decodeBodyMiddleware() gin.HandlerFunc {
+	return func(c *gin.Context) {
+		encoding := strings.ToLower(strings.TrimSpace(c.GetHeader("Content-Encoding")))
+		switch encoding {
+		case "", "identity":
+		case "gzip":
+			reader, err := gzip.NewReader(c.Request.Body)
+			if err != nil {
+				c.JSON(http.StatusBadRequest, gin.H{"error": "无效的gzip数据"})
+				c.Abort()
+				return
+			}
+			defer reader.Close()
+			c.Request.Body = reader
+			c.Request.Header.Del("Content-Encoding")
+			c.Request.ContentLength = -1
+		default:
+			c.Header("Accept-Encoding", "gzip")
+			c.JSON(http.StatusUnsupportedMediaType, gin.H{"error": "不支持的Content-Encoding: " + encoding})
+			c.Abort()
+			return
+		}
+		c.Next()
+	}
+}
+
 func authMiddleware() gin.HandlerFunc {
 	return func(c *gin.Context) {
 		authHeader := c.GetHeader("Authorization")
@@ -325,8 +404,13 @@ func main() {
 	// 初始化配置、数据库
 	InitConfig()
 
+	// 分片的唯一索引加入了 session，旧索引需先删除
+	if DB.Migrator().HasIndex(&SampleChunk{}, "idx_sample_seq") {
+		DB.Migrator().DropIndex(&SampleChunk{}, "idx_sample_seq")
+	}
+
 	// 自动迁移Auth、User和Sample模型
-	DB.AutoMigrate(&Auth{}, &User{}, &Sample{})
+	DB.AutoMigrate(&Auth{}, &User{}, &Sample{}, &SampleChunk{})
 
 	// 初始化 MQTT
 	initMQTT()
@@ -335,7 +419,7 @@ func main() {
 	r.Use(func(c *gin.Context) {
 		c.Writer.Header().Set("Access-Control-Allow-Origin", "*")
 		c.Writer.Header().Set("Access-Control-Allow-Credentials", "true")
-		c.Writer.Header().Set("Access-Control-Allow-Headers", "Content-Type, Content-Length, Authorization, X-Requested-With")
+		c.Writer.Header().Set("Access-Control-Allow-Headers", "Content-Type, Content-Length, Content-Encoding, Authorization, X-Requested-With")
 		c.Writer.Header().Set("Access-Control-Allow-Methods", "POST, OPTIONS, GET, PUT, DELETE")
 
 		if c.Request.Method == "OPTIONS" {
@@ -345,6 +429,7 @@ func main() {
 
 		c.Next()
 	})
+	r.Use(decodeBodyMiddleware())
 
 	// 注册接口
 	r.POST("/register", func(ctx *gin.Context) {
@@ -746,6 +831,143 @@ func main() {
 		c.JSON(http.StatusOK, gin.H{"message": "采集数据已成功提交"})
 	})
 
+	// 采集端分片上传接口，同一 sample_id、session 和 seq 重复上传会覆盖
+	r.POST("/collect/data/chunk", func(c *gin.Context) {
+		var req struct {
+			SampleID  string `json:"sample_id"`
+			UserUUID  string `json:"user_uuid"`
+			Session   string `json:"session"`
+			Seq       *int   `json:"seq"`
+			ChannelID []int  `json:"channel_id"`
+			Data      struct {
+				IR   []int `json:"ir"`
+				Reds []int `json:"reds"`
+			} `json:"data"`
+			Quality []int `json:"quality"`
+		}
+
+		if err := c.ShouldBindJSON(&req); err != nil {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "请求格式错误"})
+			return
+		}
+
+		sampleID := strings.TrimSpace(req.SampleID)
+		userUUID := strings.TrimSpace(req.UserUUID)
+		if sampleID == "" || userUUID == "" || req.Seq == nil || *req.Seq < 0 {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "缺少必要参数"})
+			return
+		}
+		if len(req.Data.IR) != len(req.Data.Reds) || len(req.ChannelID) != len(req.Data.IR) {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "分片数据长度不一致"})
+			return
+		}
+
+		if _, ok := findCollectSample(c, sampleID, userUUID); !ok {
+			return
+		}
+
+		payload, err := json.Marshal(chunkData{ChannelID: req.ChannelID, IR: req.Data.IR, Reds: req.Data.Reds, Quality: req.Quality})
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "分片编码失败"})
+			return
+		}
+
+		chunk := SampleChunk{SampleID: sampleID, Session: strings.TrimSpace(req.Session), Seq: *req.Seq, Payload: payload}
+		if err := DB.Clauses(clause.OnConflict{
+			Columns:   []clause.Column{{Name: "sample_id"}, {Name: "session"}, {Name: "seq"}},
+			DoUpdates: clause.AssignmentColumns([]string{"payload"}),
+		}).Create(&chunk).Error; err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "保存分片失败"})
+			return
+		}
+
+		c.JSON(http.StatusOK, gin.H{"seq": *req.Seq})
+	})
+
+	// 采集端提交分片上传，按 seq 合并为与 /collect/data 相同格式的数据
+	r.POST("/collect/data/commit", func(c *gin.Context) {
+		var req struct {
+			SampleID string `json:"sample_id"`
+			UserUUID string `json:"user_uuid"`
+			Session  string `json:"session"`
+			Chunks   int    `json:"chunks"`
+		}
+
+		if err := c.ShouldBindJSON(&req); err != nil {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "请求格式错误"})
+			return
+		}
+
+		sampleID := strings.TrimSpace(req.SampleID)
+		userUUID := strings.TrimSpace(req.UserUUID)
+		if sampleID == "" || userUUID == "" || req.Chunks <= 0 {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "缺少必要参数"})
+			return
+		}
+
+		sample, ok := findCollectSample(c, sampleID, userUUID)
+		if !ok {
+			return
+		}
+
+		session := strings.TrimSpace(req.Session)
+		var chunks []SampleChunk
+		if err := DB.Where("sample_id = ? AND session = ? AND seq < ?", sampleID, session, req.Chunks).Order("seq").Find(&chunks).Error; err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "数据库错误"})
+			return
+		}
+
+		if len(chunks) != req.Chunks {
+			have := make(map[int]bool, len(chunks))
+			for _, chunk := range chunks {
+				have[chunk.Seq] = true
+			}
+			missing := []int{}
+			for seq := 0; seq < req.Chunks; seq++ {
+				if !have[seq] {
+					missing = append(missing, seq)
+				}
+			}
+			c.JSON(http.StatusConflict, gin.H{"error": "分片不完整", "missing": missing})
+			return
+		}
+
+		var merged struct {
+			IR      []int          `json:"ir"`
+			Reds    []int          `json:"reds"`
+			Quality []chunkQuality `json:"quality,omitempty"`
+		}
+		for _, chunk := range chunks {
+			var data chunkData
+			if err := json.Unmarshal(chunk.Payload, &data); err != nil {
+				c.JSON(http.StatusInternalServerError, gin.H{"error": "分片数据损坏"})
+				return
+			}
+			merged.IR = append(merged.IR, data.IR...)
+			merged.Reds = append(merged.Reds, data.Reds...)
+			if len(data.Quality) > 0 {
+				merged.Quality = append(merged.Quality, chunkQuality{Samples: len(data.IR), Level: data.Quality})
+			}
+		}
+
+		data, err := json.Marshal(merged)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "数据编码失败"})
+			return
+		}
+
+		sample.Data = data
+		sample.Timestamp = time.Now()
+		if err := DB.Save(sample).Error; err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": "更新采样记录失败"})
+			return
+		}
+
+		DB.Where("sample_id = ? AND session = ?", sampleID, session).Delete(&SampleChunk{})
+
+		c.JSON(http.StatusOK, gin.H{"message": "采集数据已成功提交"})
+	})
+
 	// 管理员登录接口
 	r.POST("/admin/login", func(ctx *gin.Context) {
 		var req struct {
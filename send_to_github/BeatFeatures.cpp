@@ -0,0 +1,187 @@
+#include "BeatFeatures.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static_assert((BEAT_HISTORY & (BEAT_HISTORY - 1)) == 0, "BEAT_HISTORY must be a power of two");
+// The longest beat plus half a second for the peak to be confirmed
+static_assert(BEAT_HISTORY > (BEAT_MAX_SECONDS + 0.5) * BEAT_RATE_HZ, "BEAT_HISTORY must hold the longest beat");
+
+BeatFeatures::BeatFeatures()
+{
+    configure(0, 1);
+}
+
+void BeatFeatures::configure(int channels, double sampleRate)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    decimation = max(1, static_cast<int>(lround(sampleRate / BEAT_RATE_HZ)));
+    decimationFill = 0;
+    periodNs = static_cast<int64_t>(llround(1e9 * decimation / sampleRate));
+    // A decimated sample is the mean of its frames, centred on the middle one
+    centreNs = static_cast<int64_t>(llround(0.5e9 * (decimation - 1) / sampleRate));
+    rows = 0;
+    newestNs = 0;
+    total = 0;
+
+    memset(decimationSum, 0, sizeof(decimationSum));
+    memset(history, 0, sizeof(history));
+    memset(state, 0, sizeof(state));
+    for (int ch = 0; ch < DSP_MAX_CHANNELS; ch++)
+        state[ch].lastDurationMs = -1;
+}
+
+void BeatFeatures::process(const PipelineFrame &frame, const VitalsEstimator &vitals, const SignalQuality &quality)
+{
+    for (int ch = 0; ch < count; ch++)
+        decimationSum[ch] += frame.irAc[ch];
+
+    if (++decimationFill == decimation)
+    {
+        float scale = 1.0f / decimation;
+        float *row = history[rows & (BEAT_HISTORY - 1)];
+        for (int ch = 0; ch < count; ch++)
+        {
+            row[ch] = decimationSum[ch] * scale;
+            decimationSum[ch] = 0;
+        }
+        decimationFill = 0;
+        rows++;
+        newestNs = frame.timestamp_ns - centreNs;
+    }
+
+    for (int ch = 0; ch < count; ch++)
+    {
+        const ChannelVitals &v = vitals.channel(ch);
+        if (v.beats != state[ch].beats)
+        {
+            state[ch].beats = v.beats;
+            segment(ch, v.lastBeatNs, frame, quality);
+        }
+    }
+}
+
+int64_t BeatFeatures::rowFor(int64_t ns) const
+{
+    int64_t back = ns < newestNs ? (newestNs - ns + periodNs / 2) / periodNs : 0;
+    return static_cast<int64_t>(rows) - 1 - back;
+}
+
+void BeatFeatures::segment(int ch, int64_t peakNs, const PipelineFrame &frame, const SignalQuality &quality)
+{
+    State &st = state[ch];
+    int64_t previousNs = st.peakNs;
+    st.peakNs = peakNs;
+
+    int64_t first = rowFor(previousNs);
+    int64_t last = rowFor(peakNs);
+    int64_t oldest = static_cast<int64_t>(rows) - min<int64_t>(static_cast<int64_t>(rows), BEAT_HISTORY);
+    if (previousNs <= 0 || peakNs <= previousNs ||
+        peakNs - previousNs > static_cast<int64_t>(BEAT_MAX_SECONDS * 1e9) ||
+        first < oldest || last - first < 2)
+    {
+        // A gap or the first beat: start over from this peak
+        st.pending = false;
+        st.lastDurationMs = -1;
+        return;
+    }
+
+    // The pulse points up in -irAc, as in the vitals stage. The new beat's peak
+    // is the highest point in the second half of the segment and its upstroke
+    // the steepest rise before that. The foot is where the tangent at the
+    // upstroke crosses the level of the lowest point before it (intersecting
+    // tangents), which does not depend on how flat the diastole is.
+    int64_t middle = first + (last - first) / 2;
+    int64_t peak = last;
+    float peakValue = -history[last & (BEAT_HISTORY - 1)][ch];
+    for (int64_t r = last - 1; r > middle; r--)
+    {
+        float s = -history[r & (BEAT_HISTORY - 1)][ch];
+        if (s > peakValue)
+        {
+            peakValue = s;
+            peak = r;
+        }
+    }
+    int64_t upstroke = peak;
+    float steepest = 0;
+    for (int64_t r = peak; r > middle; r--)
+    {
+        float slope = history[(r - 1) & (BEAT_HISTORY - 1)][ch] - history[r & (BEAT_HISTORY - 1)][ch];
+        if (slope > steepest)
+        {
+            steepest = slope;
+            upstroke = r;
+        }
+    }
+    if (steepest <= 0)
+    {
+        st.pending = false;
+        st.lastDurationMs = -1;
+        return;
+    }
+    float footValue = peakValue;
+    for (int64_t r = middle; r < upstroke; r++)
+        footValue = min(footValue, -history[r & (BEAT_HISTORY - 1)][ch]);
+    float tangentValue = -0.5f * (history[(upstroke - 1) & (BEAT_HISTORY - 1)][ch] + history[upstroke & (BEAT_HISTORY - 1)][ch]);
+    double foot = max<double>(middle, upstroke - 0.5 - (tangentValue - footValue) / steepest);
+    int64_t footNs = newestNs - llround((static_cast<double>(rows) - 1 - foot) * periodNs);
+
+    if (st.pending)
+    {
+        // Dicrotic notch: the fall after the peak slows down, to a shoulder or a
+        // second rise, and then speeds up again. Seen on the slope, as a bump
+        // between two steeper stretches; after the band-pass a notch is often
+        // only a shoulder. The slope picking up into the next upstroke does not count
+        float threshold = static_cast<float>(BEAT_NOTCH_PROMINENCE) * steepest;
+        float low = 0;
+        float high = 0;
+        bool rising = false;
+        bool notch = false;
+        for (int64_t r = first + 1; r < upstroke && !notch; r++)
+        {
+            float s = history[(r - 1) & (BEAT_HISTORY - 1)][ch] - history[r & (BEAT_HISTORY - 1)][ch];
+            if (!rising)
+            {
+                low = min(low, s);
+                rising = s - low > threshold;
+                high = s;
+            }
+            else
+            {
+                high = max(high, s);
+                notch = high - s > threshold;
+            }
+        }
+
+        BeatRecord &out = queue[total % BEAT_QUEUE];
+        out = st.partial;
+        int durationMs = static_cast<int>(min<int64_t>((footNs - out.onset_ns + 500000) / 1000000, UINT16_MAX));
+        out.duration_ms = static_cast<uint16_t>(durationMs);
+        if (notch)
+            out.flags |= BEAT_NOTCH;
+        if (quality.level(ch) != SIGNAL_GOOD)
+            out.flags |= BEAT_POOR;
+        if (st.lastDurationMs >= 0)
+            out.variability_ms = static_cast<int16_t>(max(INT16_MIN, min(INT16_MAX, durationMs - st.lastDurationMs)));
+        else
+            out.flags |= BEAT_FIRST;
+        st.lastDurationMs = durationMs;
+        total++;
+    }
+
+    // The new beat has its onset, peak and amplitude; its end comes with the next peak
+    float amplitude = peakValue - footValue;
+    BeatRecord &next = st.partial;
+    memset(&next, 0, sizeof(next));
+    next.onset_ns = footNs;
+    next.amplitude = amplitude;
+    next.perfusion = frame.irDc[ch] > 0 ? 100.0f * amplitude / frame.irDc[ch] : 0;
+    next.rise_ms = static_cast<uint16_t>(lround((peak - foot) * periodNs / 1e6));
+    next.channel = static_cast<uint8_t>(ch);
+    next.flags = quality.level(ch) != SIGNAL_GOOD ? BEAT_POOR : 0;
+    st.pending = amplitude > 0;
+}
@@ -0,0 +1,87 @@
+#ifndef BEATFEATURES_H
+#define BEATFEATURES_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+
+#define BEAT_RATE_HZ 200           // pulse band is decimated to about this rate for segmentation
+#define BEAT_HISTORY 512           // decimated samples kept, a power of two; covers the longest beat
+#define BEAT_MAX_SECONDS 2.0       // 30 bpm; longer gaps start the segmentation over
+#define BEAT_NOTCH_PROMINENCE 0.1 // slope change around the notch, as a share of the upstroke slope
+#define BEAT_QUEUE 1024            // records kept for consumers
+
+// BeatRecord::flags
+#define BEAT_NOTCH 0x01 // dicrotic notch seen on the falling edge
+#define BEAT_POOR 0x02  // signal quality was not good at its start or end
+#define BEAT_FIRST 0x04 // no previous beat on the channel, variability is 0
+
+struct PipelineFrame;
+class VitalsEstimator;
+class SignalQuality;
+
+// One beat of one channel, foot to foot, 24 bytes. At 100 Hz a beat of raw
+// red/ir samples is some 800 bytes per channel, so these are a few percent of it.
+struct BeatRecord
+{
+    int64_t onset_ns;    // foot of the pulse
+    float amplitude;     // ir pulse height, counts
+    float perfusion;     // amplitude over ir DC, percent
+    uint16_t duration_ms; // to the next foot
+    uint16_t rise_ms;    // foot to systolic peak
+    int16_t variability_ms; // duration minus that of the previous beat
+    uint8_t channel;
+    uint8_t flags;
+};
+
+static_assert(sizeof(BeatRecord) == 24, "BeatRecord is part of the beat log format");
+
+// Beat segmentation and per-beat features for every channel.
+// Beats are the systolic peaks found by the vitals stage. When peak k+1 is
+// confirmed, the stretch of the inverted ir pulse band since peak k gives the
+// foot of beat k+1 and the falling edge of beat k, so beat k is complete and
+// its record is queued: one beat of latency. The pulse band is kept decimated
+// to BEAT_RATE_HZ, which sets the time resolution of the features.
+// Records go into a ring of BEAT_QUEUE; consumers keep their own position
+// and read everything between it and produced().
+class BeatFeatures
+{
+public:
+    BeatFeatures();
+
+    void configure(int channels, double sampleRate);
+    void process(const PipelineFrame &frame, const VitalsEstimator &vitals, const SignalQuality &quality);
+
+    uint64_t produced() const { return total; }
+    uint64_t oldest() const { return total > BEAT_QUEUE ? total - BEAT_QUEUE : 0; }
+    const BeatRecord &record(uint64_t seq) const { return queue[seq % BEAT_QUEUE]; }
+
+private:
+    struct State
+    {
+        uint32_t beats;
+        int64_t peakNs;     // last confirmed peak, 0 if none
+        bool pending;       // beat with onset, peak and amplitude, waiting for its end
+        BeatRecord partial;
+        int lastDurationMs; // -1 if none
+    };
+
+    void segment(int ch, int64_t peakNs, const PipelineFrame &frame, const SignalQuality &quality);
+    int64_t rowFor(int64_t ns) const;
+
+    int count;
+    int decimation;
+    int decimationFill;
+    int64_t periodNs;
+    int64_t centreNs;
+    uint64_t rows;
+    int64_t newestNs;
+
+    float decimationSum[DSP_MAX_CHANNELS];
+    alignas(16) float history[BEAT_HISTORY][DSP_MAX_CHANNELS];
+    State state[DSP_MAX_CHANNELS];
+
+    BeatRecord queue[BEAT_QUEUE];
+    uint64_t total;
+};
+
+#endif // BEATFEATURES_H
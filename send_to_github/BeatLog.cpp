@@ -0,0 +1,109 @@
+#include "BeatLog.h"
+#include "RecordingFile.h"
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using namespace std;
+
+static_assert(sizeof(BeatLogHeader) == 128, "beat log header layout changed");
+
+BeatLogWriter::BeatLogWriter()
+    : pending(0)
+{
+}
+
+BeatLogWriter::~BeatLogWriter()
+{
+    close();
+}
+
+string BeatLogWriter::pathFor(const string &sample_id, const string &start_unix)
+{
+    string path = RecordingWriter::pathFor(sample_id, start_unix);
+    return path.substr(0, path.rfind('.')) + ".beats";
+}
+
+bool BeatLogWriter::open(const string &path, int channels, uint32_t sampleRate,
+                         const string &sample_id, int64_t start_unix)
+{
+    close();
+
+    size_t slash = path.rfind('/');
+    if (slash != string::npos && mkdir(path.substr(0, slash).c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        perror("Failed to create recording directory");
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        perror("Failed to create beat log");
+        return false;
+    }
+
+    BeatLogHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BEAT_LOG_MAGIC;
+    header.version = BEAT_LOG_VERSION;
+    header.header_size = sizeof(BeatLogHeader);
+    header.record_size = sizeof(BeatRecord);
+    header.channels = static_cast<uint16_t>(channels);
+    header.sample_rate = sampleRate;
+    header.start_unix = start_unix;
+    memcpy(header.sample_id, sample_id.data(), min(sample_id.size(), sizeof(header.sample_id) - 1));
+    header.crc = static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef *>(&header), offsetof(BeatLogHeader, crc)));
+
+    // Synced along with the first batch
+    if (!write_all(fd, &header, sizeof(header)))
+    {
+        perror("Failed to write beat log header");
+        ::close(fd);
+        return false;
+    }
+    writer.start(fd, "beat log");
+    pending = 0;
+    return true;
+}
+
+bool BeatLogWriter::append(const BeatRecord &record)
+{
+    if (!writer.isOpen())
+        return false;
+
+    batch[pending++] = record;
+    if (pending == BEAT_LOG_BATCH)
+        return flush();
+    return true;
+}
+
+bool BeatLogWriter::flush()
+{
+    if (pending == 0)
+        return true;
+
+    bool ok = writer.write(batch, pending * sizeof(BeatRecord));
+    if (!ok)
+    {
+        // The beats are derived data, the recording still has everything
+        writer.finish();
+    }
+    pending = 0;
+    return ok;
+}
+
+bool BeatLogWriter::close()
+{
+    if (!writer.isOpen())
+        return true;
+
+    bool ok = flush();
+    return writer.finish() && ok;
+}
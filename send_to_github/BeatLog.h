@@ -0,0 +1,75 @@
+#ifndef BEATLOG_H
+#define BEATLOG_H
+
+#include <stdint.h>
+#include <string>
+#include "BeatFeatures.h"
+#include "SyncWriter.h"
+
+// Beat features of a session, next to its recording (recordings/<sample_id>_<start_unix>.beats).
+//
+// Layout, version 1 (little endian):
+//
+//   0    BeatLogHeader (128 bytes)
+//          magic         uint32  'PPGB' (0x42475050)
+//          version       uint16  BEAT_LOG_VERSION
+//          header_size   uint16  sizeof(BeatLogHeader)
+//          record_size   uint16  sizeof(BeatRecord)
+//          channels      uint16
+//          sample_rate   uint32
+//          start_unix    int64
+//          sample_id     char[64], NUL padded
+//          crc           uint32  crc32 of the 124 bytes before it
+//   128  BeatRecord (24 bytes each) in the order the beats completed, which
+//        is by end of beat across channels
+//
+// Records are fixed size, so record n is at 128 + 24 * n and a file cut short
+// by a crash is read up to its last whole record. Records are handed to a
+// writer thread in batches of BEAT_LOG_BATCH, which writes and syncs them.
+
+#define BEAT_LOG_MAGIC 0x42475050u
+#define BEAT_LOG_VERSION 1
+#define BEAT_LOG_BATCH 64
+
+struct BeatLogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t record_size;
+    uint16_t channels;
+    uint32_t sample_rate;
+    int64_t start_unix;
+    char sample_id[64];
+    uint8_t reserved[36];
+    uint32_t crc;
+};
+
+class BeatLogWriter
+{
+public:
+    BeatLogWriter();
+    ~BeatLogWriter();
+
+    // The recording's path with the extension swapped
+    static std::string pathFor(const std::string &sample_id, const std::string &start_unix);
+
+    bool open(const std::string &path, int channels, uint32_t sampleRate,
+              const std::string &sample_id, int64_t start_unix);
+    bool append(const BeatRecord &record);
+    bool close();
+
+    bool isOpen() const { return writer.isOpen(); }
+
+private:
+    BeatLogWriter(const BeatLogWriter &) = delete;
+    BeatLogWriter &operator=(const BeatLogWriter &) = delete;
+
+    bool flush();
+
+    SyncWriter writer;
+    int pending;
+    BeatRecord batch[BEAT_LOG_BATCH];
+};
+
+#endif // BEATLOG_H
@@ -0,0 +1,93 @@
+#include "ChannelAligner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+ChannelAligner::ChannelAligner()
+    : count(0), streamCount(0), period(1)
+{
+    reset();
+}
+
+bool ChannelAligner::setup(int channels, double sampleRate, int streams)
+{
+    if (channels <= 0 || channels > DSP_MAX_CHANNELS || sampleRate <= 0 || streams <= 0 || streams > ALIGN_MAX_STREAMS)
+    {
+        cerr << "Invalid aligner setup: " << channels << " channels, " << sampleRate << " Hz, " << streams << " streams" << endl;
+        count = 0;
+        return false;
+    }
+
+    count = channels;
+    streamCount = streams;
+    period = static_cast<int64_t>(llround(1e9 / sampleRate));
+    reset();
+    return true;
+}
+
+void ChannelAligner::reset()
+{
+    filled = 0;
+    next = 0;
+    grid = 0;
+    lastTimestamp = 0;
+    memset(readNs, 0, sizeof(readNs));
+    memset(value, 0, sizeof(value));
+}
+
+bool ChannelAligner::process(int64_t timestamp_ns, const int32_t *offset_ns, const float *const *in, float *const *out, int64_t &gridNs)
+{
+    for (int c = 0; c < count; c++)
+        readNs[next][c] = timestamp_ns + offset_ns[c];
+    for (int s = 0; s < streamCount; s++)
+        memcpy(value[s][next], in[s], count * sizeof(float));
+
+    next = (next + 1) % ALIGN_HISTORY;
+    int64_t target = lastTimestamp;
+    lastTimestamp = timestamp_ns;
+    if (filled < ALIGN_HISTORY)
+    {
+        if (++filled < ALIGN_HISTORY)
+            return false;
+        grid = target;
+    }
+    else
+    {
+        // Uniform steps, nudged towards the frame clock
+        grid += period;
+        int64_t error = target - grid;
+        if (llabs(error) > ALIGN_RESYNC_PERIODS * period)
+            grid = target;
+        else
+            grid += error / (1 << ALIGN_STEER_SHIFT);
+    }
+    gridNs = grid;
+
+    // Oldest first: the grid point sits between p1 and p2
+    int s0 = next;
+    int s1 = (next + 1) % ALIGN_HISTORY;
+    int s2 = (next + 2) % ALIGN_HISTORY;
+    int s3 = (next + 3) % ALIGN_HISTORY;
+
+    for (int c = 0; c < count; c++)
+    {
+        int64_t t1 = readNs[s1][c];
+        int64_t t2 = readNs[s2][c];
+        float u = t2 > t1 ? static_cast<float>(static_cast<double>(grid - t1) / (t2 - t1)) : 1.0f;
+        u = min(1.0f, max(0.0f, u));
+        float u2 = u * u;
+        float u3 = u2 * u;
+
+        for (int s = 0; s < streamCount; s++)
+        {
+            float p0 = value[s][s0][c], p1 = value[s][s1][c], p2 = value[s][s2][c], p3 = value[s][s3][c];
+            out[s][c] = p1 + 0.5f * ((p2 - p0) * u +
+                                     (2 * p0 - 5 * p1 + 4 * p2 - p3) * u2 +
+                                     (3 * (p1 - p2) + p3 - p0) * u3);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef CHANNELALIGNER_H
+#define CHANNELALIGNER_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+
+// COLLECT_ALIGN_CHANNELS=1 puts the aligner into the signal pipeline
+#define ALIGN_ENV "COLLECT_ALIGN_CHANNELS"
+#define ALIGN_MAX_STREAMS 4
+#define ALIGN_HISTORY 4      // samples per channel, the cubic's support
+#define ALIGN_STEER_SHIFT 6  // grid follows the frame clock with 1/64 of its error per frame
+#define ALIGN_RESYNC_PERIODS 2
+
+// Resamples channels read one after another onto one uniform time grid.
+// Channel ch of frame n was read at timestamp_ns + offset_ns[ch]. The grid
+// advances by one nominal period per frame and is steered slowly towards the
+// frame timestamps, so it stays uniform through timer jitter but follows the
+// sensor clock; a gap of more than ALIGN_RESYNC_PERIODS restarts it.
+// Each grid point lies between the last two reads of a channel, one frame
+// back, and is interpolated with a Catmull-Rom cubic over the last
+// ALIGN_HISTORY samples: one frame of latency, O(1) state and work per channel.
+// Up to ALIGN_MAX_STREAMS arrays per frame (e.g. red/ir AC and DC) share the
+// read times. Because the filters before it are time invariant, aligning
+// their output is the same as aligning the raw reads.
+class ChannelAligner
+{
+public:
+    ChannelAligner();
+
+    bool setup(int channels, double sampleRate, int streams);
+    void reset();
+
+    // Takes one frame; returns true and fills out[] (and gridNs) once the
+    // history covers a grid point, false for the first frames
+    bool process(int64_t timestamp_ns, const int32_t *offset_ns, const float *const *in, float *const *out, int64_t &gridNs);
+
+    int channels() const { return count; }
+
+private:
+    int count;
+    int streamCount;
+    int64_t period;
+    int filled;
+    int next;
+    int64_t grid;
+    int64_t lastTimestamp;
+
+    int64_t readNs[ALIGN_HISTORY][DSP_MAX_CHANNELS];
+    float value[ALIGN_MAX_STREAMS][ALIGN_HISTORY][DSP_MAX_CHANNELS];
+};
+
+#endif // CHANNELALIGNER_H
@@ -0,0 +1,156 @@
+#include "ChannelFilter.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+ChannelFilterBank::ChannelFilterBank()
+    : count(0), primed(false), dcAlpha(0)
+{
+    memset(section, 0, sizeof(section));
+    reset();
+}
+
+bool ChannelFilterBank::setup(int channels, double sampleRate, double lowHz, double highHz)
+{
+    if (channels <= 0 || channels > DSP_MAX_CHANNELS || sampleRate <= 0 ||
+        lowHz <= 0 || highHz <= lowHz || highHz >= sampleRate / 2)
+    {
+        cerr << "Invalid filter setup: " << channels << " channels, " << sampleRate << " Hz" << endl;
+        count = 0;
+        return false;
+    }
+
+    count = channels;
+    dcAlpha = static_cast<float>(1.0 - exp(-2 * M_PI * FILTER_DC_HZ / sampleRate));
+
+    // Butterworth sections from the bilinear transform (Q = 1/sqrt(2)), normalised by a0
+    const double q = M_SQRT1_2;
+    for (int s = 0; s < FILTER_SECTIONS; s++)
+    {
+        bool highPass = s == 0;
+        double w0 = 2 * M_PI * (highPass ? lowHz : highHz) / sampleRate;
+        double cw = cos(w0);
+        double alpha = sin(w0) / (2 * q);
+        double a0 = 1 + alpha;
+        double b0 = highPass ? (1 + cw) / 2 : (1 - cw) / 2;
+        double b1 = highPass ? -(1 + cw) : 1 - cw;
+
+        section[s].b0 = static_cast<float>(b0 / a0);
+        section[s].b1 = static_cast<float>(b1 / a0);
+        section[s].b2 = static_cast<float>(b0 / a0);
+        section[s].a1 = static_cast<float>(-2 * cw / a0);
+        section[s].a2 = static_cast<float>((1 - alpha) / a0);
+    }
+
+    reset();
+    return true;
+}
+
+void ChannelFilterBank::reset()
+{
+    primed = false;
+    memset(level, 0, sizeof(level));
+    memset(z1, 0, sizeof(z1));
+    memset(z2, 0, sizeof(z2));
+}
+
+const char *ChannelFilterBank::kernelName()
+{
+#if defined(DSP_NEON)
+    return "neon";
+#elif defined(DSP_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void ChannelFilterBank::process(const uint32_t *in, float *ac, float *dc)
+{
+    if (!primed)
+    {
+        // Start the tracker on the first reading instead of ramping up from 0
+        for (int ch = 0; ch < count; ch++)
+            level[ch] = static_cast<float>(in[ch]);
+        primed = true;
+    }
+
+    int ch = 0;
+#if defined(DSP_NEON)
+    const float32_t alpha = dcAlpha;
+    for (; ch + 4 <= count; ch += 4)
+    {
+        float32x4_t x = vcvtq_f32_u32(vld1q_u32(in + ch));
+        float32x4_t lv = vld1q_f32(level + ch);
+        lv = vmlaq_n_f32(lv, vsubq_f32(x, lv), alpha);
+        vst1q_f32(level + ch, lv);
+        vst1q_f32(dc + ch, lv);
+
+        float32x4_t v = vsubq_f32(x, lv);
+        for (int s = 0; s < FILTER_SECTIONS; s++)
+        {
+            const Biquad &b = section[s];
+            float32x4_t w1 = vld1q_f32(z1[s] + ch);
+            float32x4_t w2 = vld1q_f32(z2[s] + ch);
+            float32x4_t y = vmlaq_n_f32(w1, v, b.b0);
+            w1 = vmlsq_n_f32(vmlaq_n_f32(w2, v, b.b1), y, b.a1);
+            w2 = vmlsq_n_f32(vmulq_n_f32(v, b.b2), y, b.a2);
+            vst1q_f32(z1[s] + ch, w1);
+            vst1q_f32(z2[s] + ch, w2);
+            v = y;
+        }
+        vst1q_f32(ac + ch, v);
+    }
+#elif defined(DSP_SSE2)
+    const __m128 alpha = _mm_set1_ps(dcAlpha);
+    for (; ch + 4 <= count; ch += 4)
+    {
+        // Counts are 18 bit, so the signed conversion is exact
+        __m128 x = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + ch)));
+        __m128 lv = _mm_load_ps(level + ch);
+        lv = _mm_add_ps(lv, _mm_mul_ps(alpha, _mm_sub_ps(x, lv)));
+        _mm_store_ps(level + ch, lv);
+        _mm_storeu_ps(dc + ch, lv);
+
+        __m128 v = _mm_sub_ps(x, lv);
+        for (int s = 0; s < FILTER_SECTIONS; s++)
+        {
+            const Biquad &b = section[s];
+            __m128 w1 = _mm_load_ps(z1[s] + ch);
+            __m128 w2 = _mm_load_ps(z2[s] + ch);
+            __m128 y = _mm_add_ps(w1, _mm_mul_ps(v, _mm_set1_ps(b.b0)));
+            w1 = _mm_sub_ps(_mm_add_ps(w2, _mm_mul_ps(v, _mm_set1_ps(b.b1))), _mm_mul_ps(y, _mm_set1_ps(b.a1)));
+            w2 = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps(b.b2)), _mm_mul_ps(y, _mm_set1_ps(b.a2)));
+            _mm_store_ps(z1[s] + ch, w1);
+            _mm_store_ps(z2[s] + ch, w2);
+            v = y;
+        }
+        _mm_storeu_ps(ac + ch, v);
+    }
+#endif
+    processScalar(ch, in, ac, dc);
+}
+
+void ChannelFilterBank::processScalar(int from, const uint32_t *in, float *ac, float *dc)
+{
+    for (int ch = from; ch < count; ch++)
+    {
+        float x = static_cast<float>(in[ch]);
+        float lv = level[ch] + dcAlpha * (x - level[ch]);
+        level[ch] = lv;
+        dc[ch] = lv;
+
+        float v = x - lv;
+        for (int s = 0; s < FILTER_SECTIONS; s++)
+        {
+            const Biquad &b = section[s];
+            float y = b.b0 * v + z1[s][ch];
+            z1[s][ch] = b.b1 * v - b.a1 * y + z2[s][ch];
+            z2[s][ch] = b.b2 * v - b.a2 * y;
+            v = y;
+        }
+        ac[ch] = v;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CHANNELFILTER_H
+#define CHANNELFILTER_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+
+#define FILTER_LOW_HZ 0.5
+#define FILTER_HIGH_HZ 5.0
+#define FILTER_DC_HZ 0.2
+#define FILTER_SECTIONS 2
+
+// Streaming DC tracker and pulse band-pass for every channel of a frame.
+// The DC level is a one-pole low-pass of the raw counts; the AC output is the
+// raw value minus that level, band-limited by a 2nd order Butterworth high-pass
+// at lowHz and low-pass at highHz (transposed direct form II biquads).
+// All channels share the coefficients, so one frame is a handful of vector
+// multiply-adds per DSP_LANES channels. Single precision is enough once the
+// DC level is taken out; the 18-bit counts fit the mantissa exactly.
+class ChannelFilterBank
+{
+public:
+    ChannelFilterBank();
+
+    bool setup(int channels, double sampleRate, double lowHz = FILTER_LOW_HZ, double highHz = FILTER_HIGH_HZ);
+    void reset();
+
+    // One frame: channels() raw values in, AC and DC per channel out
+    void process(const uint32_t *in, float *ac, float *dc);
+
+    int channels() const { return count; }
+    static const char *kernelName();
+
+private:
+    struct Biquad
+    {
+        float b0, b1, b2, a1, a2;
+    };
+
+    void processScalar(int from, const uint32_t *in, float *ac, float *dc);
+
+    int count;
+    bool primed;
+    float dcAlpha;
+    Biquad section[FILTER_SECTIONS];
+
+    alignas(16) float level[DSP_MAX_CHANNELS];
+    alignas(16) float z1[FILTER_SECTIONS][DSP_MAX_CHANNELS];
+    alignas(16) float z2[FILTER_SECTIONS][DSP_MAX_CHANNELS];
+};
+
+#endif // CHANNELFILTER_H
@@ -0,0 +1,214 @@
+#include "CompressedBody.h"
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+CompressedBody::CompressedBody(JsonStreamWriter &source, UploadCodec codec, int level)
+    : source(source), mode(codec), valid(true), inputLength(0), inputOffset(0),
+      sourceDone(false), finished(false), totalIn(0), totalOut(0), encodeNs(0)
+{
+    memset(&zs, 0, sizeof(zs));
+#ifdef USE_ZSTD
+    zctx = nullptr;
+#else
+    if (mode == CODEC_ZSTD)
+    {
+        cerr << "zstd support not compiled in, sending gzip" << endl;
+        mode = CODEC_GZIP;
+    }
+#endif
+
+    if (mode == CODEC_GZIP)
+    {
+        // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+        if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            cerr << "deflateInit2() 失败" << endl;
+            mode = CODEC_IDENTITY;
+            valid = false;
+        }
+    }
+#ifdef USE_ZSTD
+    else if (mode == CODEC_ZSTD)
+    {
+        zctx = ZSTD_createCCtx();
+        if (!zctx)
+        {
+            cerr << "ZSTD_createCCtx() 失败" << endl;
+            mode = CODEC_IDENTITY;
+            valid = false;
+        }
+        else
+        {
+            ZSTD_CCtx_setParameter(zctx, ZSTD_c_compressionLevel, level);
+        }
+    }
+#endif
+
+    source.rewind();
+}
+
+CompressedBody::~CompressedBody()
+{
+    if (mode == CODEC_GZIP)
+        deflateEnd(&zs);
+#ifdef USE_ZSTD
+    if (zctx)
+        ZSTD_freeCCtx(zctx);
+#endif
+}
+
+const char *CompressedBody::contentEncoding() const
+{
+    if (mode == CODEC_IDENTITY)
+        return nullptr;
+    return codecName(mode);
+}
+
+long long CompressedBody::size() const
+{
+    if (mode == CODEC_IDENTITY)
+        return static_cast<long long>(source.size());
+    return -1;
+}
+
+void CompressedBody::refill()
+{
+    inputLength = source.read(input, sizeof(input));
+    inputOffset = 0;
+    totalIn += inputLength;
+    if (inputLength == 0)
+        sourceDone = true;
+}
+
+size_t CompressedBody::read(char *buffer, size_t length)
+{
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+
+    size_t n;
+    if (mode == CODEC_GZIP)
+    {
+        n = readGzip(buffer, length);
+    }
+#ifdef USE_ZSTD
+    else if (mode == CODEC_ZSTD)
+    {
+        n = readZstd(buffer, length);
+    }
+#endif
+    else
+    {
+        n = source.read(buffer, length);
+        totalIn += n;
+    }
+
+    // A body that could not be produced in full must not reach the server
+    if (source.failed())
+        n = CURL_READFUNC_ABORT;
+
+    // An encoder error comes back as CURL_READFUNC_ABORT, which is not a byte count
+    if (n != CURL_READFUNC_ABORT)
+        totalOut += n;
+    encodeNs += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count();
+    return n;
+}
+
+size_t CompressedBody::readGzip(char *buffer, size_t length)
+{
+    zs.next_out = reinterpret_cast<Bytef *>(buffer);
+    zs.avail_out = static_cast<uInt>(length);
+
+    // Returning 0 ends the upload, so keep going until the buffer is full or the stream ends
+    while (zs.avail_out > 0 && !finished)
+    {
+        if (inputOffset == inputLength && !sourceDone)
+            refill();
+
+        zs.next_in = reinterpret_cast<Bytef *>(input + inputOffset);
+        zs.avail_in = static_cast<uInt>(inputLength - inputOffset);
+
+        int ret = deflate(&zs, sourceDone ? Z_FINISH : Z_NO_FLUSH);
+        inputOffset = inputLength - zs.avail_in;
+        if (ret == Z_STREAM_END)
+        {
+            finished = true;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            cerr << "deflate() 失败: " << ret << endl;
+            return CURL_READFUNC_ABORT;
+        }
+    }
+    return length - zs.avail_out;
+}
+
+#ifdef USE_ZSTD
+size_t CompressedBody::readZstd(char *buffer, size_t length)
+{
+    ZSTD_outBuffer out = {buffer, length, 0};
+    while (out.pos < out.size && !finished)
+    {
+        if (inputOffset == inputLength && !sourceDone)
+            refill();
+
+        ZSTD_inBuffer in = {input, inputLength, inputOffset};
+        size_t ret = ZSTD_compressStream2(zctx, &out, &in, sourceDone ? ZSTD_e_end : ZSTD_e_continue);
+        inputOffset = in.pos;
+        if (ZSTD_isError(ret))
+        {
+            cerr << "ZSTD_compressStream2() 失败: " << ZSTD_getErrorName(ret) << endl;
+            return CURL_READFUNC_ABORT;
+        }
+        if (sourceDone && ret == 0)
+            finished = true;
+    }
+    return out.pos;
+}
+#endif
+
+bool CompressedBody::rewind()
+{
+    source.rewind();
+    inputLength = 0;
+    inputOffset = 0;
+    sourceDone = false;
+    finished = false;
+    totalIn = 0;
+    totalOut = 0;
+    encodeNs = 0;
+
+    if (mode == CODEC_GZIP)
+        return deflateReset(&zs) == Z_OK;
+#ifdef USE_ZSTD
+    if (mode == CODEC_ZSTD)
+        return !ZSTD_isError(ZSTD_CCtx_reset(zctx, ZSTD_reset_session_only));
+#endif
+    return true;
+}
+
+size_t CompressedBody::curlRead(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    return static_cast<CompressedBody *>(userp)->read(buffer, size * nitems);
+}
+
+int CompressedBody::curlSeek(void *userp, curl_off_t offset, int origin)
+{
+    if (offset != 0 || origin != SEEK_SET)
+        return CURL_SEEKFUNC_CANTSEEK;
+    return static_cast<CompressedBody *>(userp)->rewind() ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+const char *CompressedBody::codecName(UploadCodec codec)
+{
+    switch (codec)
+    {
+    case CODEC_GZIP:
+        return "gzip";
+    case CODEC_ZSTD:
+        return "zstd";
+    default:
+        return "identity";
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef COMPRESSEDBODY_H
+#define COMPRESSEDBODY_H
+
+#include <stddef.h>
+#include <zlib.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#include "JsonStreamWriter.h"
+
+enum UploadCodec
+{
+    CODEC_IDENTITY,
+    CODEC_GZIP,
+    CODEC_ZSTD
+};
+
+// Compresses a JsonStreamWriter on the fly inside curl's read callback.
+// Only one input and one output buffer exist at a time, so the uncompressed
+// body is never held in memory. The compressed length is not known up front
+// and bodies other than identity go out with chunked transfer encoding.
+// zstd is only compiled in with USE_ZSTD (CONFIG += zstd in collect.pro).
+class CompressedBody
+{
+public:
+    CompressedBody(JsonStreamWriter &source, UploadCodec codec, int level);
+    ~CompressedBody();
+
+    // False if the codec could not be set up; codec() is then CODEC_IDENTITY
+    bool isValid() const { return valid; }
+    UploadCodec codec() const { return mode; }
+
+    // Value for the Content-Encoding header, nullptr for identity
+    const char *contentEncoding() const;
+
+    // -1 when the length is only known after compressing
+    long long size() const;
+
+    size_t read(char *buffer, size_t length);
+    bool rewind();
+
+    static size_t curlRead(char *buffer, size_t size, size_t nitems, void *userp);
+    static int curlSeek(void *userp, curl_off_t offset, int origin);
+
+    // Stats for the last pass over the body
+    size_t bytesIn() const { return totalIn; }
+    size_t bytesOut() const { return totalOut; }
+    double encodeMs() const { return encodeNs / 1e6; }
+
+    static const char *codecName(UploadCodec codec);
+
+private:
+    CompressedBody(const CompressedBody &) = delete;
+    CompressedBody &operator=(const CompressedBody &) = delete;
+
+    size_t readGzip(char *buffer, size_t length);
+#ifdef USE_ZSTD
+    size_t readZstd(char *buffer, size_t length);
+#endif
+    void refill();
+
+    JsonStreamWriter &source;
+    UploadCodec mode;
+    bool valid;
+
+    z_stream zs;
+#ifdef USE_ZSTD
+    ZSTD_CCtx *zctx;
+#endif
+
+    char input[16384];
+    size_t inputLength;
+    size_t inputOffset;
+    bool sourceDone;
+    bool finished;
+
+    size_t totalIn;
+    size_t totalOut;
+    long long encodeNs;
+};
+
+#endif // COMPRESSEDBODY_H
@@ -0,0 +1,23 @@
+#ifndef DSPCOMMON_H
+#define DSPCOMMON_H
+
+// Shared limits and SIMD selection for the per-frame signal stages.
+// Stages keep their state as one array per quantity indexed by channel, so a
+// frame is processed DSP_LANES channels at a time. DSP_SCALAR forces the plain
+// C++ loops, e.g. to compare them against the vector kernels.
+
+#define DSP_MAX_CHANNELS 128
+
+#if !defined(DSP_SCALAR) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define DSP_NEON 1
+#define DSP_LANES 4
+#elif !defined(DSP_SCALAR) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define DSP_SSE2 1
+#define DSP_LANES 4
+#else
+#define DSP_LANES 1
+#endif
+
+#endif // DSPCOMMON_H
@@ -0,0 +1,117 @@
+#include "FrameSource.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+
+FramePool::FreeList::~FreeList()
+{
+    for (size_t i = 0; i < frames.size(); i++)
+        delete frames[i];
+}
+
+FramePool::FramePool(size_t maxFree)
+    : freeList(make_shared<FreeList>())
+{
+    freeList->maxFree = maxFree;
+}
+
+shared_ptr<MaxData> FramePool::acquire()
+{
+    MaxData *frame = nullptr;
+    {
+        lock_guard<mutex> lock(freeList->mutex);
+        if (!freeList->frames.empty())
+        {
+            frame = freeList->frames.back();
+            freeList->frames.pop_back();
+        }
+    }
+    if (!frame)
+        frame = new MaxData();
+
+    shared_ptr<FreeList> owner = freeList;
+    return shared_ptr<MaxData>(frame, [owner](MaxData *released)
+                               {
+                                   lock_guard<mutex> lock(owner->mutex);
+                                   if (owner->frames.size() < owner->maxFree)
+                                       owner->frames.push_back(released);
+                                   else
+                                       delete released;
+                               });
+}
+
+void FrameSource::emitFrame(const MaxData &data)
+{
+    shared_ptr<MaxData> frame = pool.acquire();
+    int channels = max(0, min(data.channels, FRAME_MAX_CHANNELS));
+    frame->timestamp_ns = data.timestamp_ns;
+    frame->channels = channels;
+    memcpy(frame->redData, data.redData, channels * sizeof(uint32_t));
+    memcpy(frame->irData, data.irData, channels * sizeof(uint32_t));
+    memcpy(frame->channel_id, data.channel_id, channels * sizeof(uint32_t));
+    memcpy(frame->offset_ns, data.offset_ns, channels * sizeof(int32_t));
+    emit dataReady(frame);
+}
+
+FramePacer::FramePacer(double speed)
+    : speed(speed < 0 ? 0 : speed), stopping(false), inFlight(0), frames(0), maxLag(0)
+{
+}
+
+void FramePacer::start()
+{
+    lock_guard<mutex> lock(flightMutex);
+    inFlight = 0;
+    frames = 0;
+    maxLag = chrono::nanoseconds(0);
+    begin = chrono::steady_clock::now();
+}
+
+bool FramePacer::wait(int64_t offset_ns)
+{
+    {
+        unique_lock<mutex> lock(flightMutex);
+        cv.wait(lock, [this] { return stopping || inFlight < FRAME_MAX_IN_FLIGHT; });
+        if (stopping)
+            return false;
+        inFlight++;
+        frames++;
+    }
+
+    if (speed > 0)
+    {
+        chrono::steady_clock::time_point due = begin + chrono::nanoseconds(static_cast<int64_t>(offset_ns / speed));
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (due > now)
+            this_thread::sleep_until(due);
+        else
+            maxLag = max(maxLag, chrono::duration_cast<chrono::nanoseconds>(now - due));
+    }
+    return true;
+}
+
+void FramePacer::handled()
+{
+    lock_guard<mutex> lock(flightMutex);
+    if (inFlight > 0)
+        inFlight--;
+    cv.notify_all();
+}
+
+void FramePacer::quit()
+{
+    lock_guard<mutex> lock(flightMutex);
+    stopping = true;
+    cv.notify_all();
+}
+
+void FramePacer::report(const char *what) const
+{
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    qDebug() << what << frames << "frames in" << seconds << "s,"
+             << (seconds > 0 ? frames / seconds : 0) << "frames/s, max lag"
+             << maxLag.count() / 1e6 << "ms";
+}
@@ -0,0 +1,126 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QObject>
+#include <QMetaType>
+#include "RecordingFile.h"
+
+#define FRAME_MAX_CHANNELS 128
+
+// Frames a source that runs ahead of real time may have queued at the consumer
+#define FRAME_MAX_IN_FLIGHT 64
+#define FRAME_POOL_FRAMES FRAME_MAX_IN_FLIGHT
+
+// One reading of every channel; only the first channels entries are used
+struct MaxData
+{
+    int64_t timestamp_ns; // CLOCK_REALTIME of the read, or the recorded time on replay
+    int channels;
+    uint32_t redData[FRAME_MAX_CHANNELS], irData[FRAME_MAX_CHANNELS], channel_id[FRAME_MAX_CHANNELS];
+    int32_t offset_ns[FRAME_MAX_CHANNELS]; // when each channel was read, relative to timestamp_ns
+};
+
+// Read-only handle; the frame goes back to its pool when the last one is dropped.
+// This is what crosses the thread boundary, so a queued signal copies a pointer
+// instead of the full-size frame.
+typedef std::shared_ptr<const MaxData> MaxDataRef;
+
+Q_DECLARE_METATYPE(MaxDataRef)
+
+// Free list of frames, the same scheme as SampleBlockPool.
+// Frames may be released from any thread and after the source is gone;
+// up to maxFree are kept for reuse, the rest are freed.
+class FramePool
+{
+public:
+    explicit FramePool(size_t maxFree = FRAME_POOL_FRAMES);
+
+    std::shared_ptr<MaxData> acquire();
+
+private:
+    struct FreeList
+    {
+        ~FreeList();
+
+        std::mutex mutex;
+        std::vector<MaxData *> frames;
+        size_t maxFree;
+    };
+
+    std::shared_ptr<FreeList> freeList;
+};
+
+// Where MaxPlot gets its frames from: the sensor chain, a recording being
+// replayed or a synthetic signal.
+// run() is called on the acquisition thread and returns when the session is over;
+// Quit() may be called from any thread to end it early.
+class FrameSource : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameSource(QObject *parent = nullptr) : QObject(parent) {}
+    virtual ~FrameSource() {}
+
+    // Channel count, rate and sensor setup of the frames this source emits
+    virtual RecordingProfile profile() const = 0;
+
+    virtual void run() = 0;
+    virtual void Quit() = 0;
+
+    // Called by the consumer after each frame; lets sources that run ahead of real time wait for it
+    virtual void frameHandled() {}
+
+signals:
+    void dataReady(const MaxDataRef &data);
+
+protected:
+    // Emits dataReady with a pooled copy of the first data.channels entries
+    void emitFrame(const MaxData &data);
+
+private:
+    FramePool pool;
+};
+
+// Emission schedule for sources that are not driven by hardware.
+// At speed N frame t is due at start + t / N (t relative to the first frame), so
+// lag does not accumulate; speed 0 emits as fast as the consumer keeps up.
+// Whatever the speed, at most FRAME_MAX_IN_FLIGHT frames are ahead of handled(),
+// which bounds the queued signals without a blocking connection.
+class FramePacer
+{
+public:
+    explicit FramePacer(double speed);
+
+    // Starts the schedule at the first frame. A quit() that came earlier
+    // still holds, so the source returns without emitting anything.
+    void start();
+
+    // Blocks until the frame at offset_ns may be emitted; false once quit() was called
+    bool wait(int64_t offset_ns);
+
+    void handled();
+    void quit();
+
+    // One log line with frames/s and the worst lag behind schedule
+    void report(const char *what) const;
+
+private:
+    double speed;
+
+    std::mutex flightMutex;
+    std::condition_variable cv;
+    bool stopping;
+    int inFlight;
+
+    uint64_t frames;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::nanoseconds maxLag;
+};
+
+#endif // FRAMESOURCE_H
@@ -0,0 +1,373 @@
+#include "HttpClient.h"
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+HttpClient::Request::Request()
+    : post(false), timeoutSec(30), priority(HTTP_PRIORITY_HIGH), throttled(false), readFn(nullptr), seekFn(nullptr), readData(nullptr), bodySize(-1)
+{
+}
+
+HttpClient &HttpClient::instance()
+{
+    static HttpClient client;
+    return client;
+}
+
+HttpClient::HttpClient()
+    : multi(nullptr), started(false), stopping(false), running(0), rate(HTTP_UPLOAD_BYTES_PER_SEC), tokens(0)
+{
+    refilled = chrono::steady_clock::now();
+
+    multi = curl_multi_init();
+    if (!multi)
+    {
+        cerr << "curl_multi_init() 失败" << endl;
+        return;
+    }
+
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(HTTP_MAX_TRANSFERS));
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(HTTP_MAX_HOST_CONNECTIONS));
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, static_cast<long>(HTTP_MAX_TRANSFERS));
+
+    worker = thread(&HttpClient::run, this);
+    started = true;
+}
+
+HttpClient::~HttpClient()
+{
+    shutdown();
+}
+
+void HttpClient::shutdown()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (!started)
+            return;
+        started = false;
+        stopping = true;
+    }
+    curl_multi_wakeup(multi);
+    worker.join();
+
+    curl_multi_cleanup(multi);
+    multi = nullptr;
+}
+
+void HttpClient::submit(const Request &request, Callback done)
+{
+    Transfer *transfer = new Transfer();
+    transfer->request = request;
+    transfer->done = done;
+    transfer->easy = nullptr;
+    transfer->headers = nullptr;
+    transfer->client = this;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (started)
+        {
+            queue[request.priority == HTTP_PRIORITY_LOW ? 1 : 0].push_back(transfer);
+            curl_multi_wakeup(multi);
+            return;
+        }
+    }
+
+    // Already shut down
+    transfer->response.result = CURLE_FAILED_INIT;
+    if (done)
+        done(transfer->response);
+    delete transfer;
+}
+
+bool HttpClient::perform(const Request &request, Response &response)
+{
+    mutex doneMutex;
+    condition_variable doneCond;
+    bool finished = false;
+
+    submit(request, [&](const Response &result)
+           {
+               lock_guard<mutex> lock(doneMutex);
+               response = result;
+               finished = true;
+               doneCond.notify_one();
+           });
+
+    unique_lock<mutex> lock(doneMutex);
+    doneCond.wait(lock, [&]
+                  { return finished; });
+    return response.ok();
+}
+
+size_t HttpClient::collectResponse(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t totalSize = size * nmemb;
+    static_cast<string *>(userp)->append(static_cast<char *>(contents), totalSize);
+    return totalSize;
+}
+
+void HttpClient::setBandwidthLimit(size_t bytesPerSec)
+{
+    rate = bytesPerSec;
+    curl_multi_wakeup(multi);
+}
+
+void HttpClient::refillTokens(size_t limit)
+{
+    // Up to a quarter second of burst, but never less than one 16 KB read
+    double burst = max(limit / 4.0, 16384.0);
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - refilled).count();
+    refilled = now;
+    tokens = min(burst, tokens + elapsed * limit);
+}
+
+size_t HttpClient::takeTokens(size_t wanted)
+{
+    size_t limit = rate;
+    if (limit == 0)
+        return wanted;
+
+    refillTokens(limit);
+    size_t granted = min(wanted, static_cast<size_t>(tokens));
+    tokens -= granted;
+    return granted;
+}
+
+void HttpClient::returnTokens(size_t unused)
+{
+    tokens += unused;
+}
+
+long HttpClient::msUntilTokens()
+{
+    size_t limit = rate;
+    if (limit == 0)
+        return 0;
+
+    refillTokens(limit);
+
+    // Wait for about 10 ms worth of bytes so resumes are not one byte at a time
+    double wanted = limit / 100.0 - tokens;
+    if (wanted <= 0)
+        return 0;
+    return static_cast<long>(wanted * 1000 / limit) + 1;
+}
+
+size_t HttpClient::throttledRead(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    Transfer *transfer = static_cast<Transfer *>(userp);
+    HttpClient *client = transfer->client;
+
+    size_t granted = client->takeTokens(size * nitems);
+    if (granted == 0)
+    {
+        client->paused.push_back(transfer);
+        return CURL_READFUNC_PAUSE;
+    }
+
+    size_t n = transfer->request.readFn(buffer, 1, granted, transfer->request.readData);
+    if (n <= granted)
+        client->returnTokens(granted - n);
+    return n;
+}
+
+void HttpClient::resumePaused()
+{
+    if (paused.empty() || msUntilTokens() > 0)
+        return;
+
+    // Unpausing can call the read callback right away and pause again, so work on a copy
+    vector<Transfer *> waiting;
+    waiting.swap(paused);
+    for (size_t i = 0; i < waiting.size(); i++)
+        curl_easy_pause(waiting[i]->easy, CURLPAUSE_CONT);
+}
+
+void HttpClient::startTransfer(Transfer *transfer)
+{
+    CURL *easy;
+    if (!idle.empty())
+    {
+        easy = idle.back();
+        idle.pop_back();
+        curl_easy_reset(easy);
+    }
+    else
+    {
+        easy = curl_easy_init();
+    }
+
+    if (!easy)
+    {
+        cerr << "curl_easy_init() 失败" << endl;
+        transfer->response.result = CURLE_FAILED_INIT;
+        if (transfer->done)
+            transfer->done(transfer->response);
+        delete transfer;
+        return;
+    }
+
+    const Request &request = transfer->request;
+    transfer->easy = easy;
+
+    curl_easy_setopt(easy, CURLOPT_URL, request.url.c_str());
+    if (request.throttled)
+    {
+        // A throttled body takes as long as the bandwidth limit makes it, so
+        // there is no overall deadline, only one for connecting and for stalls
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, request.timeoutSec);
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, static_cast<long>(HTTP_STALL_BYTES_PER_SEC));
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, request.timeoutSec);
+    }
+    else
+    {
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT, request.timeoutSec);
+    }
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(HTTP_DNS_CACHE_SECONDS));
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, collectResponse);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &transfer->response.body);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer);
+
+    if (request.post)
+    {
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        if (request.readFn)
+        {
+            if (request.throttled)
+            {
+                curl_easy_setopt(easy, CURLOPT_READFUNCTION, throttledRead);
+                curl_easy_setopt(easy, CURLOPT_READDATA, transfer);
+            }
+            else
+            {
+                curl_easy_setopt(easy, CURLOPT_READFUNCTION, request.readFn);
+                curl_easy_setopt(easy, CURLOPT_READDATA, request.readData);
+            }
+            if (request.seekFn)
+            {
+                curl_easy_setopt(easy, CURLOPT_SEEKFUNCTION, request.seekFn);
+                curl_easy_setopt(easy, CURLOPT_SEEKDATA, request.readData);
+            }
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, request.bodySize);
+        }
+        else
+        {
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDS, request.body.c_str());
+            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body.size()));
+        }
+    }
+
+    for (size_t i = 0; i < request.headers.size(); i++)
+        transfer->headers = curl_slist_append(transfer->headers, request.headers[i].c_str());
+    if (transfer->headers)
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+
+    curl_multi_add_handle(multi, easy);
+    running++;
+}
+
+void HttpClient::finishTransfer(CURL *easy, CURLcode result)
+{
+    Transfer *transfer = nullptr;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, reinterpret_cast<char **>(&transfer));
+    curl_multi_remove_handle(multi, easy);
+    running--;
+    paused.erase(remove(paused.begin(), paused.end(), transfer), paused.end());
+
+    transfer->response.result = result;
+    if (result == CURLE_OK)
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &transfer->response.status);
+    else
+        cerr << "HTTP " << transfer->request.url << " 失败: " << curl_easy_strerror(result) << endl;
+
+    // The handle goes back to the pool; the connection itself stays in the multi cache
+    idle.push_back(easy);
+    curl_slist_free_all(transfer->headers);
+
+    if (transfer->done)
+        transfer->done(transfer->response);
+    delete transfer;
+}
+
+void HttpClient::run()
+{
+    while (true)
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (stopping && queue[0].empty() && queue[1].empty() && running == 0)
+                break;
+        }
+
+        // Admit new transfers up to the limit; low priority leaves one slot free
+        while (running < HTTP_MAX_TRANSFERS)
+        {
+            Transfer *transfer = nullptr;
+            {
+                lock_guard<mutex> lock(queueMutex);
+                if (!queue[0].empty())
+                {
+                    transfer = queue[0].front();
+                    queue[0].pop_front();
+                }
+                else if (!queue[1].empty() && running < HTTP_MAX_TRANSFERS - 1)
+                {
+                    transfer = queue[1].front();
+                    queue[1].pop_front();
+                }
+            }
+            if (!transfer)
+                break;
+            startTransfer(transfer);
+        }
+
+        resumePaused();
+
+        int stillRunning = 0;
+        curl_multi_perform(multi, &stillRunning);
+
+        CURLMsg *msg;
+        int remaining;
+        while ((msg = curl_multi_info_read(multi, &remaining)))
+        {
+            if (msg->msg == CURLMSG_DONE)
+                finishTransfer(msg->easy_handle, msg->data.result);
+        }
+
+        long timeout = paused.empty() ? 1000 : max(msUntilTokens(), 1L);
+        curl_multi_poll(multi, nullptr, 0, static_cast<int>(min(timeout, 1000L)), nullptr);
+    }
+
+    for (size_t i = 0; i < idle.size(); i++)
+        curl_easy_cleanup(idle[i]);
+    idle.clear();
+}
+
+string HttpClient::escape(const string &value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    string out;
+    out.reserve(value.size() * 3);
+    for (size_t i = 0; i < value.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            out += static_cast<char>(c);
+        }
+        else
+        {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+        }
+    }
+    return out;
+}
@@ -0,0 +1,137 @@
+#ifndef HTTPCLIENT_H
+#define HTTPCLIENT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <curl/curl.h>
+
+#define HTTP_MAX_TRANSFERS 4
+#define HTTP_MAX_HOST_CONNECTIONS HTTP_MAX_TRANSFERS
+#define HTTP_DNS_CACHE_SECONDS 600
+#define HTTP_UPLOAD_BYTES_PER_SEC (64 * 1024)
+#define HTTP_STALL_BYTES_PER_SEC 1 // a throttled transfer slower than this for timeoutSec has stalled
+
+enum HttpPriority
+{
+    HTTP_PRIORITY_HIGH, // lookups, commits, live chunks
+    HTTP_PRIORITY_LOW   // backlog and whole-session bodies
+};
+
+// Process-wide HTTP service.
+// All transfers run on one curl multi handle driven by a single I/O thread,
+// so connections to sp.grifcc.top stay open between requests, the resolved
+// address is cached, and at most HTTP_MAX_TRANSFERS requests are in flight.
+// Low priority requests never take the last free slot, so a lookup or a
+// commit does not queue behind a backlog. Throttled request bodies share one
+// token bucket (HTTP_UPLOAD_BYTES_PER_SEC) and are paused inside the read
+// callback when it runs dry, which leaves uplink room for the live MQTT stream.
+// Needs curl_global_init() before first use and shutdown() before
+// curl_global_cleanup().
+class HttpClient
+{
+public:
+    struct Request
+    {
+        Request();
+
+        std::string url;
+        bool post;
+        long timeoutSec; // whole request; for throttled bodies, connecting and any stall
+        HttpPriority priority;
+        bool throttled; // count readFn bodies against the upload bandwidth limit
+        std::vector<std::string> headers;
+
+        // POST body, either a plain string or pulled through readFn/seekFn
+        std::string body;
+        curl_read_callback readFn;
+        curl_seek_callback seekFn;
+        void *readData;
+        curl_off_t bodySize;
+    };
+
+    struct Response
+    {
+        Response() : result(CURLE_OK), status(0) {}
+
+        CURLcode result;
+        long status;
+        std::string body;
+
+        bool ok() const { return result == CURLE_OK && status >= 200 && status < 300; }
+    };
+
+    typedef std::function<void(const Response &)> Callback;
+
+    static HttpClient &instance();
+
+    // Queue a request; done runs on the I/O thread and must not block
+    void submit(const Request &request, Callback done);
+
+    // Blocking helper for worker threads. Never call it from a Callback.
+    bool perform(const Request &request, Response &response);
+
+    // Bytes per second for throttled bodies, 0 for no limit
+    void setBandwidthLimit(size_t bytesPerSec);
+
+    // Finishes queued transfers and stops the I/O thread
+    void shutdown();
+
+    // RFC 3986 percent-encoding for query parameters
+    static std::string escape(const std::string &value);
+
+private:
+    struct Transfer
+    {
+        Request request;
+        Callback done;
+        Response response;
+        CURL *easy;
+        struct curl_slist *headers;
+        HttpClient *client;
+    };
+
+    HttpClient();
+    ~HttpClient();
+    HttpClient(const HttpClient &) = delete;
+    HttpClient &operator=(const HttpClient &) = delete;
+
+    void run();
+    void startTransfer(Transfer *transfer);
+    void finishTransfer(CURL *easy, CURLcode result);
+
+    static size_t collectResponse(void *contents, size_t size, size_t nmemb, void *userp);
+    static size_t throttledRead(char *buffer, size_t size, size_t nitems, void *userp);
+
+    // Token bucket, I/O thread only apart from the atomic rate
+    void refillTokens(size_t limit);
+    size_t takeTokens(size_t wanted);
+    void returnTokens(size_t unused);
+    long msUntilTokens();
+    void resumePaused();
+
+    CURLM *multi;
+    std::thread worker;
+    bool started;
+
+    std::mutex queueMutex;
+    std::deque<Transfer *> queue[2]; // by HttpPriority
+    bool stopping;
+
+    // I/O thread only
+    int running;
+    std::vector<CURL *> idle;
+    std::vector<Transfer *> paused;
+
+    std::atomic<size_t> rate;
+    double tokens;
+    std::chrono::steady_clock::time_point refilled;
+};
+
+#endif // HTTPCLIENT_H
@@ -0,0 +1,472 @@
+#include "JsonStreamWriter.h"
+#include <cstring>
+#include <cstdio>
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static inline int count_digits(uint32_t v)
+{
+    if (v < 10)
+        return 1;
+    if (v < 100)
+        return 2;
+    if (v < 1000)
+        return 3;
+    if (v < 10000)
+        return 4;
+    if (v < 100000)
+        return 5;
+    if (v < 1000000)
+        return 6;
+    if (v < 10000000)
+        return 7;
+    if (v < 100000000)
+        return 8;
+    if (v < 1000000000)
+        return 9;
+    return 10;
+}
+
+static inline size_t int_length(int value)
+{
+    uint32_t v = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+    return count_digits(v) + (value < 0 ? 1 : 0);
+}
+
+// Length of c once escaped the way nlohmann::json::dump() does it
+static inline size_t escaped_length(unsigned char c)
+{
+    if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t')
+        return 2;
+    if (c < 0x20)
+        return 6;
+    return 1;
+}
+
+static size_t escape_char(unsigned char c, char *out)
+{
+    switch (c)
+    {
+    case '"':
+        memcpy(out, "\\\"", 2);
+        return 2;
+    case '\\':
+        memcpy(out, "\\\\", 2);
+        return 2;
+    case '\b':
+        memcpy(out, "\\b", 2);
+        return 2;
+    case '\f':
+        memcpy(out, "\\f", 2);
+        return 2;
+    case '\n':
+        memcpy(out, "\\n", 2);
+        return 2;
+    case '\r':
+        memcpy(out, "\\r", 2);
+        return 2;
+    case '\t':
+        memcpy(out, "\\t", 2);
+        return 2;
+    default:
+        snprintf(out, 7, "\\u%04x", c);
+        return 6;
+    }
+}
+
+size_t JsonStreamWriter::formatInt(int value, char *out)
+{
+    size_t sign = 0;
+    uint32_t v = static_cast<uint32_t>(value);
+    if (value < 0)
+    {
+        *out++ = '-';
+        v = 0u - v;
+        sign = 1;
+    }
+
+    int digits = count_digits(v);
+    char *p = out + digits;
+
+    // Two digits per division, filled from the back
+    while (v >= 100)
+    {
+        uint32_t pair = (v % 100) * 2;
+        v /= 100;
+        *--p = DIGIT_PAIRS[pair + 1];
+        *--p = DIGIT_PAIRS[pair];
+    }
+    if (v >= 10)
+    {
+        *--p = DIGIT_PAIRS[v * 2 + 1];
+        *--p = DIGIT_PAIRS[v * 2];
+    }
+    else
+    {
+        *--p = static_cast<char>('0' + v);
+    }
+    return digits + sign;
+}
+
+JsonStreamWriter::JsonStreamWriter()
+    : partCount(0), depth(0)
+{
+    first[0] = true;
+    rewind();
+}
+
+JsonStreamWriter::Part *JsonStreamWriter::addText(const char *text, size_t length)
+{
+    Part *last = partCount > 0 ? &parts[partCount - 1] : nullptr;
+    while (length > 0)
+    {
+        if (!last || last->type != PART_TEXT || last->length == sizeof(last->text))
+        {
+            if (partCount == MAX_PARTS)
+                return nullptr;
+            last = &parts[partCount++];
+            last->type = PART_TEXT;
+            last->length = 0;
+        }
+        size_t n = sizeof(last->text) - last->length;
+        if (n > length)
+            n = length;
+        memcpy(last->text + last->length, text, n);
+        last->length += n;
+        text += n;
+        length -= n;
+    }
+    return last;
+}
+
+void JsonStreamWriter::separator()
+{
+    if (!first[depth])
+        addText(",", 1);
+    first[depth] = false;
+}
+
+void JsonStreamWriter::openObject()
+{
+    addText("{", 1);
+    if (depth + 1 < MAX_DEPTH)
+        first[++depth] = true;
+}
+
+void JsonStreamWriter::closeObject()
+{
+    addText("}", 1);
+    if (depth > 0)
+        depth--;
+}
+
+void JsonStreamWriter::key(const char *name)
+{
+    separator();
+    addText("\"", 1);
+    addText(name, strlen(name));
+    addText("\":", 2);
+}
+
+void JsonStreamWriter::string(const std::string *value)
+{
+    if (partCount == MAX_PARTS)
+        return;
+    Part &part = parts[partCount++];
+    part.type = PART_STRING;
+    part.str = value;
+    part.length = 0;
+}
+
+void JsonStreamWriter::integer(long long value)
+{
+    char text[24];
+    int n = snprintf(text, sizeof(text), "%lld", value);
+    addText(text, n);
+}
+
+void JsonStreamWriter::intArray(const IntSpan *spans, size_t spanCount)
+{
+    if (partCount == MAX_PARTS)
+        return;
+    Part &part = parts[partCount++];
+    part.type = PART_ARRAY;
+    part.spans = spans;
+    part.source = nullptr;
+    part.spanCount = spanCount;
+    part.length = 0;
+}
+
+void JsonStreamWriter::intArray(IntSpanSource *source)
+{
+    if (partCount == MAX_PARTS)
+        return;
+    Part &part = parts[partCount++];
+    part.type = PART_ARRAY;
+    part.spans = nullptr;
+    part.source = source;
+    part.spanCount = source->spanCount();
+    part.length = 0;
+}
+
+IntSpan JsonStreamWriter::spanAt(const Part &part, size_t index) const
+{
+    if (!part.source)
+        return part.spans[index];
+
+    IntSpan span = {nullptr, 0};
+    if (!part.source->span(index, span))
+    {
+        // Encoded as if empty; failed() tells the caller not to send it
+        sourceFailed = true;
+        span.data = nullptr;
+        span.count = 0;
+    }
+    return span;
+}
+
+size_t JsonStreamWriter::size() const
+{
+    size_t total = 0;
+    for (int i = 0; i < partCount; i++)
+    {
+        const Part &part = parts[i];
+        if (part.type == PART_TEXT)
+        {
+            total += part.length;
+        }
+        else if (part.type == PART_STRING)
+        {
+            total += 2;
+            for (size_t k = 0; k < part.str->size(); k++)
+                total += escaped_length(static_cast<unsigned char>((*part.str)[k]));
+        }
+        else
+        {
+            size_t elements = 0;
+            for (size_t s = 0; s < part.spanCount; s++)
+            {
+                IntSpan span = spanAt(part, s);
+                for (size_t k = 0; k < span.count; k++)
+                    total += int_length(span.data[k]);
+                elements += span.count;
+            }
+            total += 2 + (elements > 0 ? elements - 1 : 0);
+        }
+    }
+    return total;
+}
+
+void JsonStreamWriter::rewind()
+{
+    partIndex = 0;
+    offset = 0;
+    spanIndex = 0;
+    element = 0;
+    pendingLength = 0;
+    pendingOffset = 0;
+    sourceFailed = false;
+}
+
+size_t JsonStreamWriter::fillString(const Part &part, char *out, size_t length)
+{
+    // element: 0 before the opening quote, 1 inside, 2 done
+    const std::string &str = *part.str;
+    size_t w = 0;
+
+    if (element == 0)
+    {
+        out[w++] = '"';
+        element = 1;
+    }
+
+    while (w < length && element == 1)
+    {
+        if (offset == str.size())
+        {
+            out[w++] = '"';
+            element = 2;
+            break;
+        }
+
+        size_t run = offset;
+        while (run < str.size() && run - offset < length - w && escaped_length(static_cast<unsigned char>(str[run])) == 1)
+            run++;
+        if (run > offset)
+        {
+            memcpy(out + w, str.data() + offset, run - offset);
+            w += run - offset;
+            offset = run;
+            continue;
+        }
+
+        char token[8];
+        size_t n = escape_char(static_cast<unsigned char>(str[offset++]), token);
+        size_t fit = n < length - w ? n : length - w;
+        memcpy(out + w, token, fit);
+        w += fit;
+        if (fit < n)
+        {
+            memcpy(pending, token + fit, n - fit);
+            pendingLength = n - fit;
+            pendingOffset = 0;
+            break;
+        }
+    }
+    return w;
+}
+
+size_t JsonStreamWriter::fillArray(const Part &part, char *out, size_t length)
+{
+    // spanIndex == spanCount + 1 marks the closing bracket as written
+    size_t w = 0;
+
+    if (element == 0 && spanIndex == 0 && offset == 0)
+    {
+        out[w++] = '[';
+        offset = 0;
+        element = 1;
+    }
+
+    while (w < length)
+    {
+        IntSpan span = {nullptr, 0};
+        while (spanIndex < part.spanCount)
+        {
+            span = spanAt(part, spanIndex);
+            if (offset < span.count)
+                break;
+            spanIndex++;
+            offset = 0;
+        }
+
+        if (spanIndex >= part.spanCount)
+        {
+            out[w++] = ']';
+            spanIndex = part.spanCount + 1;
+            break;
+        }
+
+        // Fast path while there is room for the largest token, ",-2147483648"
+        if (length - w >= 12)
+        {
+            if (element == 1)
+            {
+                w += formatInt(span.data[offset++], out + w);
+                element++;
+            }
+            size_t end = offset + (length - w) / 12;
+            if (end > span.count)
+                end = span.count;
+            char *p = out + w;
+            for (size_t k = offset; k < end; k++)
+            {
+                *p++ = ',';
+                p += formatInt(span.data[k], p);
+            }
+            w = p - out;
+            element += end - offset;
+            offset = end;
+            continue;
+        }
+
+        int value = span.data[offset++];
+        bool comma = element > 1;
+        element++;
+
+        char token[16];
+        size_t n = 0;
+        if (comma)
+            token[n++] = ',';
+        n += formatInt(value, token + n);
+
+        size_t fit = n < length - w ? n : length - w;
+        memcpy(out + w, token, fit);
+        w += fit;
+        if (fit < n)
+        {
+            memcpy(pending, token + fit, n - fit);
+            pendingLength = n - fit;
+            pendingOffset = 0;
+            break;
+        }
+    }
+    return w;
+}
+
+size_t JsonStreamWriter::read(char *buffer, size_t length)
+{
+    size_t written = 0;
+    while (written < length)
+    {
+        if (pendingOffset < pendingLength)
+        {
+            size_t n = pendingLength - pendingOffset;
+            if (n > length - written)
+                n = length - written;
+            memcpy(buffer + written, pending + pendingOffset, n);
+            pendingOffset += n;
+            written += n;
+            continue;
+        }
+
+        if (partIndex >= partCount)
+            break;
+
+        const Part &part = parts[partIndex];
+        bool done = false;
+        if (part.type == PART_TEXT)
+        {
+            size_t n = part.length - offset;
+            if (n > length - written)
+                n = length - written;
+            memcpy(buffer + written, part.text + offset, n);
+            offset += n;
+            written += n;
+            done = offset == part.length;
+        }
+        else if (part.type == PART_STRING)
+        {
+            written += fillString(part, buffer + written, length - written);
+            done = element == 2;
+        }
+        else
+        {
+            written += fillArray(part, buffer + written, length - written);
+            done = spanIndex == part.spanCount + 1;
+        }
+
+        if (done)
+        {
+            partIndex++;
+            offset = 0;
+            spanIndex = 0;
+            element = 0;
+        }
+    }
+    return written;
+}
+
+size_t JsonStreamWriter::curlRead(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    return static_cast<JsonStreamWriter *>(userp)->read(buffer, size * nitems);
+}
+
+int JsonStreamWriter::curlSeek(void *userp, curl_off_t offset, int origin)
+{
+    // curl only seeks back to the start when it has to resend the body
+    if (offset != 0 || origin != SEEK_SET)
+        return CURL_SEEKFUNC_CANTSEEK;
+    static_cast<JsonStreamWriter *>(userp)->rewind();
+    return CURL_SEEKFUNC_OK;
+}
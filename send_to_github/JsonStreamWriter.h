@@ -0,0 +1,111 @@
+#ifndef JSONSTREAMWRITER_H
+#define JSONSTREAMWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <curl/curl.h>
+
+// Run of ints taken straight from the caller's session buffer
+struct IntSpan
+{
+    const int *data;
+    size_t count;
+};
+
+// Spans produced on demand, for arrays too large to hold in memory at once.
+// The writer asks for them in order on every pass over the body (size() is one).
+class IntSpanSource
+{
+public:
+    virtual ~IntSpanSource() {}
+
+    virtual size_t spanCount() const = 0;
+
+    // out stays valid until the next call; false when the span cannot be produced
+    virtual bool span(size_t index, IntSpan &out) = 0;
+};
+
+// Pull-style JSON encoder for upload bodies.
+// The document is described once as a short list of parts (keys, strings,
+// ints, int arrays that point into existing buffers) and then pulled out in
+// whatever piece size curl asks for, so the body never exists as one string.
+// Output is byte-identical to nlohmann::json::dump() as long as keys are
+// added in sorted order, which is how nlohmann orders object members.
+class JsonStreamWriter
+{
+public:
+    JsonStreamWriter();
+
+    void openObject();
+    void closeObject();
+    void key(const char *name);
+
+    // Referenced, not copied: value and spans must outlive the writer
+    void string(const std::string *value);
+    void integer(long long value);
+    void intArray(const IntSpan *spans, size_t spanCount);
+    void intArray(IntSpanSource *source);
+
+    // Exact encoded length, computed without encoding
+    size_t size() const;
+
+    // A span source failed; the body is incomplete and must not be sent
+    bool failed() const { return sourceFailed; }
+
+    size_t read(char *buffer, size_t length);
+    void rewind();
+
+    // CURLOPT_READFUNCTION / CURLOPT_SEEKFUNCTION adapters, userp is the writer
+    static size_t curlRead(char *buffer, size_t size, size_t nitems, void *userp);
+    static int curlSeek(void *userp, curl_off_t offset, int origin);
+
+    // Writes the decimal form of value to out, returns the number of chars
+    static size_t formatInt(int value, char *out);
+
+private:
+    enum PartType
+    {
+        PART_TEXT,
+        PART_STRING,
+        PART_ARRAY
+    };
+
+    struct Part
+    {
+        PartType type;
+        char text[32];
+        size_t length;
+        const std::string *str;
+        const IntSpan *spans;
+        IntSpanSource *source;
+        size_t spanCount;
+    };
+
+    static const int MAX_PARTS = 48;
+    static const int MAX_DEPTH = 8;
+
+    Part *addText(const char *text, size_t length);
+    void separator();
+
+    size_t fillString(const Part &part, char *out, size_t length);
+    size_t fillArray(const Part &part, char *out, size_t length);
+    IntSpan spanAt(const Part &part, size_t index) const;
+
+    Part parts[MAX_PARTS];
+    int partCount;
+    bool first[MAX_DEPTH];
+    int depth;
+
+    // Pull cursor
+    int partIndex;
+    size_t offset;
+    size_t spanIndex;
+    size_t element;
+    char pending[16];
+    size_t pendingLength;
+    size_t pendingOffset;
+    mutable bool sourceFailed;
+};
+
+#endif // JSONSTREAMWRITER_H
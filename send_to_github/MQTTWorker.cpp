@@ -5,6 +5,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QTimer>
 
 MQTTWorker::MQTTWorker(const char *address, const char *clientId, const char *topic, int qos, long timeout, QObject *parent)
     : QObject(parent),
@@ -13,20 +14,214 @@ MQTTWorker::MQTTWorker(const char *address, const char *clientId, const char *to
       TOPIC(topic),
       QOS_LEVEL(qos),
       TIMEOUT_MS(timeout),
-      running(true)
+      running(true),
+      connected(false),
+      reconnectPending(false),
+      replayPending(false),
+      backoffMs(MQTT_BACKOFF_MIN_MS),
+      jitter(std::random_device()()),
+      spool(MQTT_SPOOL_DIR)
 {
     MQTTClient_create(&client, ADDRESS.toUtf8().constData(), CLIENTID.toUtf8().constData(), MQTTCLIENT_PERSISTENCE_NONE, NULL);
+
+    // With callbacks set the client runs its own thread, which sends the keepalive pings while
+    // nothing is published between sessions and reports a dropped link right away
+    MQTTClient_setCallbacks(client, this, &MQTTWorker::onConnectionLost, &MQTTWorker::onMessageArrived, NULL);
+}
+
+MQTTWorker::~MQTTWorker()
+{
+    MQTTClient_destroy(&client);
+}
+
+// Runs in the MQTT thread, so a slow broker never blocks the GUI
+void MQTTWorker::start()
+{
+    if (!spool.open())
+    {
+        qDebug() << "MQTT spool unavailable, frames will be dropped while offline";
+    }
+
+    connected = connectBroker();
+    if (connected)
+    {
+        emit ready();
+        replaySpool();
+    }
+    else
+    {
+        scheduleReconnect();
+    }
+}
+
+bool MQTTWorker::connectBroker()
+{
     MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+    conn_opts.connectTimeout = static_cast<int>(TIMEOUT_MS / 1000);
+    conn_opts.keepAliveInterval = 20;
+    conn_opts.cleansession = 1;
+    // reliable allows a single QoS 1 message in flight; without it the client takes
+    // MQTT_REPLAY_WINDOW, which the spool replay relies on
+    conn_opts.reliable = 0;
     int rc;
     if ((rc = MQTTClient_connect(client, &conn_opts)) != MQTTCLIENT_SUCCESS)
     {
         qDebug() << "无法连接到 MQTT 代理，返回代码：" << rc;
-        running = false;
+        return false;
     }
+    return true;
 }
 
-MQTTWorker::~MQTTWorker()
+void MQTTWorker::onConnectionLost(void *context, char *cause)
+{
+    qDebug() << "MQTT connection lost:" << (cause ? cause : "unknown cause");
+    QMetaObject::invokeMethod(static_cast<MQTTWorker *>(context), "connectionLost", Qt::QueuedConnection);
+}
+
+int MQTTWorker::onMessageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message)
+{
+    // Nothing is subscribed; required by the client once callbacks are set
+    Q_UNUSED(context);
+    Q_UNUSED(topicLen);
+    MQTTClient_freeMessage(&message);
+    MQTTClient_free(topicName);
+    return 1;
+}
+
+void MQTTWorker::connectionLost()
 {
+    if (!running || !connected)
+        return;
+
+    connected = false;
+    emit disconnected();
+    scheduleReconnect();
+}
+
+void MQTTWorker::scheduleReconnect()
+{
+    if (!running || reconnectPending)
+        return;
+
+    // Equal jitter: wait between half and the full backoff so devices do not reconnect in lockstep
+    std::uniform_int_distribution<int> dis(backoffMs / 2, backoffMs);
+    reconnectPending = true;
+    QTimer::singleShot(dis(jitter), this, &MQTTWorker::reconnect);
+    backoffMs = qMin(backoffMs * 2, MQTT_BACKOFF_MAX_MS);
+}
+
+void MQTTWorker::reconnect()
+{
+    reconnectPending = false;
+    if (!running || connected)
+        return;
+
+    connected = connectBroker();
+    if (!connected)
+    {
+        scheduleReconnect();
+        return;
+    }
+
+    qDebug() << "MQTT reconnected, replaying" << spool.pendingBytes() << "spooled bytes";
+    backoffMs = MQTT_BACKOFF_MIN_MS;
+    emit ready();
+    replaySpool();
+}
+
+void MQTTWorker::replaySpool()
+{
+    replayPending = false;
+    if (!running || !connected)
+        return;
+
+    // One window per pass: the records go out back to back, then the acks are collected
+    // in order, so the spool drains at a window per round trip instead of a record.
+    // Queued live frames get into the spool behind us between passes.
+    std::string record;
+    MQTTClient_deliveryToken tokens[MQTT_REPLAY_WINDOW];
+    int published = 0;
+    bool stalled = false;
+    while (published < MQTT_REPLAY_WINDOW && spool.peek(record))
+    {
+        if (!publishPayload(QByteArray::fromRawData(record.data(), static_cast<int>(record.size())), &tokens[published]))
+        {
+            stalled = true;
+            break;
+        }
+        published++;
+    }
+
+    // A QoS 1 publish is only queued in the client until the broker acks it, and without
+    // persistence it is lost with the link; a record leaves the spool once acked. The acks
+    // arrive in order, so after the first wait the others have mostly come in already.
+    for (int i = 0; i < published; i++)
+    {
+        int rc = MQTTClient_waitForCompletion(client, tokens[i], TIMEOUT_MS);
+        if (rc != MQTTCLIENT_SUCCESS)
+        {
+            qDebug() << "Spooled frame not acknowledged, rc" << rc;
+            stalled = true;
+            break;
+        }
+        spool.pop();
+    }
+    // The rest goes out again on the next pass
+    spool.unpeek();
+
+    if (stalled)
+    {
+        if (!connected)
+            return; // publishPayload already scheduled the reconnect
+        if (!MQTTClient_isConnected(client))
+        {
+            connectionLost();
+            return;
+        }
+        replayPending = true;
+        QTimer::singleShot(MQTT_BACKOFF_MIN_MS, this, &MQTTWorker::replaySpool);
+        return;
+    }
+
+    if (!spool.empty())
+    {
+        replayPending = true;
+        QTimer::singleShot(0, this, &MQTTWorker::replaySpool);
+    }
+}
+
+void MQTTWorker::spoolPayload(const QByteArray &payload)
+{
+    if (!spool.append(payload.constData(), payload.size()))
+    {
+        qDebug() << "MQTT spool rejected frame, dropped" << spool.droppedBytes() << "bytes so far";
+    }
+}
+
+bool MQTTWorker::publishPayload(const QByteArray &payload, MQTTClient_deliveryToken *delivery)
+{
+    MQTTClient_message pubmsg = MQTTClient_message_initializer;
+    pubmsg.payload = (void *)payload.constData();
+    pubmsg.payloadlen = payload.size();
+    pubmsg.qos = QOS_LEVEL;
+    pubmsg.retained = 0;
+    MQTTClient_deliveryToken token;
+
+    int rc = MQTTClient_publishMessage(client, TOPIC.toUtf8().constData(), &pubmsg, &token);
+    if (rc != MQTTCLIENT_SUCCESS)
+    {
+        qDebug() << "发布消息失败，返回代码：" << rc;
+        if (!MQTTClient_isConnected(client))
+        {
+            connected = false;
+            emit disconnected();
+            scheduleReconnect();
+        }
+        return false;
+    }
+    if (delivery)
+        *delivery = token;
+    return true;
 }
 
 void MQTTWorker::publishMessage(const QString &message)
@@ -54,42 +249,70 @@ void MQTTWorker::publishMessage(const QString &message)
         return;
     }
 
-    for (int i = 0; i < channelArray.size(); ++i)
-    {
-        int channel = channelArray[i].toInt();
-        int ir = irArray[i].toInt();
-        int red = redArray[i].toInt();
-
-        qDebug() << "Channel:" << channel << "IR:" << ir << "Red:" << red;
-    }
-
     QJsonDocument outputDoc(jsonObj);
     QString jsonString = QString::fromUtf8(outputDoc.toJson(QJsonDocument::Compact));
 
+#ifdef MQTT_DEBUG_FRAMES
     qDebug() << "Publishing MQTT message:" << jsonString;
+#endif
 
-    // 准备 MQTT 消息
-    MQTTClient_message pubmsg = MQTTClient_message_initializer;
     QByteArray byteArray = jsonString.toUtf8();
-    pubmsg.payload = (void *)byteArray.constData();
-    pubmsg.payloadlen = byteArray.size();
-    pubmsg.qos = QOS_LEVEL;
-    pubmsg.retained = 0;
-    MQTTClient_deliveryToken token;
 
-    // 发布 JSON 消息
-    int rc = MQTTClient_publishMessage(client, TOPIC.toUtf8().constData(), &pubmsg, &token);
-    if (rc != MQTTCLIENT_SUCCESS)
+    // QoS 1 frames always go through the spool and leave it once the broker has acked
+    // them, so a frame in flight when the link drops is sent again after the reconnect.
+    // Otherwise the spool only keeps the order while offline or still replaying.
+    bool acked = QOS_LEVEL > 0 && spool.isOpen();
+    if (acked || !connected || !spool.empty())
     {
-        qDebug() << "发布消息失败，返回代码：" << rc;
+        spoolPayload(byteArray);
+        if (!connected)
+        {
+            scheduleReconnect();
+        }
+        else if (!replayPending)
+        {
+            // Frames queued behind this one join the same window
+            replayPending = true;
+            QTimer::singleShot(0, this, &MQTTWorker::replaySpool);
+        }
         return;
     }
+
+    // 发布 JSON 消息
+    if (!publishPayload(byteArray))
+        spoolPayload(byteArray);
+}
+
+// Periodic summaries go to TOPIC/subtopic. They are superseded every few seconds,
+// so unlike the frames they are not spooled while the broker is away.
+void MQTTWorker::publishSummary(const QString &subtopic, const QString &message)
+{
+    if (!running || !connected)
+        return;
+
+    QByteArray payload = message.toUtf8();
+    QByteArray topic = (TOPIC + "/" + subtopic).toUtf8();
+
+    MQTTClient_message pubmsg = MQTTClient_message_initializer;
+    pubmsg.payload = (void *)payload.constData();
+    pubmsg.payloadlen = payload.size();
+    pubmsg.qos = 0;
+    pubmsg.retained = 0;
+    MQTTClient_deliveryToken token;
+
+    int rc = MQTTClient_publishMessage(client, topic.constData(), &pubmsg, &token);
+    if (rc != MQTTCLIENT_SUCCESS)
+        qDebug() << "Summary publish failed on" << subtopic << "rc" << rc;
 }
 
 void MQTTWorker::stop()
 {
     running = false;
+    spool.close();
     emit finished();
+    if (!connected)
+        return;
+    connected = false;
     int rc = MQTTClient_disconnect(client, 1000);
     printf("Closing MQTT client!");
     if (rc != MQTTCLIENT_SUCCESS)
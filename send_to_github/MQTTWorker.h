@@ -4,8 +4,17 @@
 #include <QObject>
 #include <MQTTClient.h>
 #include <QString>
+#include <QByteArray>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <random>
+#include "MqttSpool.h"
+
+#define MQTT_SPOOL_DIR "spool/mqtt"
+#define MQTT_BACKOFF_MIN_MS 500
+#define MQTT_BACKOFF_MAX_MS 30000
+#define MQTT_REPLAY_WINDOW 10 // QoS 1 records in flight, paho's limit once reliable is off
+// Build with -DMQTT_DEBUG_FRAMES to print every published frame
 
 class MQTTWorker : public QObject
 {
@@ -14,14 +23,34 @@ public:
     MQTTWorker(const char *address, const char *clientId, const char *topic, int qos, long timeout, QObject *parent = nullptr);
     ~MQTTWorker();
 
+    bool isReady() const { return connected; }
+
 public slots:
+    void start();
     void publishMessage(const QString &message);
+    void publishSummary(const QString &subtopic, const QString &message);
     void stop();
 
 signals:
+    void ready();
+    void disconnected();
     void finished();
 
+private slots:
+    void reconnect();
+    void replaySpool();
+    void connectionLost();
+
 private:
+    bool connectBroker();
+    bool publishPayload(const QByteArray &payload, MQTTClient_deliveryToken *delivery = nullptr);
+    void spoolPayload(const QByteArray &payload);
+    void scheduleReconnect();
+
+    // Paho callbacks, called on the client's own thread
+    static void onConnectionLost(void *context, char *cause);
+    static int onMessageArrived(void *context, char *topicName, int topicLen, MQTTClient_message *message);
+
     MQTTClient client;
     QString ADDRESS;
     QString CLIENTID;
@@ -29,6 +58,12 @@ private:
     int QOS_LEVEL;
     long TIMEOUT_MS;
     bool running;
+    bool connected;
+    bool reconnectPending;
+    bool replayPending;
+    int backoffMs;
+    std::mt19937 jitter;
+    MqttSpool spool;
 };
 
 #endif // MQTTWORKER_H
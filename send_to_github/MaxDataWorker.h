@@ -2,12 +2,7 @@
 #define MAXDATAWORKER_H
 
 #include <QObject>
-#include <QVector>
-#include "max30102.h"
-#include <chrono>
-#include <atomic>
-#include <signal.h>
-#include <ctime>
+#include "FrameSource.h"
 
 
 class MaxDataWorker : public QObject
@@ -15,7 +10,7 @@ class MaxDataWorker : public QObject
     Q_OBJECT
 
 public:
-    explicit MaxDataWorker(QObject *parent,MAX30102 *sensor);
+    explicit MaxDataWorker(QObject *parent, FrameSource *source);
     ~MaxDataWorker();
 
     void doWork();
@@ -24,9 +19,8 @@ signals:
     void finishRead();
 
 public:
-    MAX30102 *max30102; 
+    FrameSource *source;
 
 };
 
 #endif // MAXDATAWORKER_H
-
@@ -8,6 +8,10 @@
 #include <QDateTime>
 #include <MQTTClient.h>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <QMessageBox>
 #include <QTimer>
 #include <QFuture>
@@ -30,19 +34,29 @@ using namespace nlohmann;
 
 MaxPlot::MaxPlot(QWidget *parent, QRCodeGenerator *qrGenerator)
     : QMainWindow(parent), plot(new QCustomPlot(this)), logo(new QLabel(this)),
-      sampleCount(0), windowSize(50), isTouching(false), qr(qrGenerator)
+      sampleCount(0), windowSize(50), isTouching(false), qr(qrGenerator),
+      uploader(SessionUploader::instance())
 {
     Init_GUI_SHOW();
 }
 
 MaxPlot::~MaxPlot()
 {
+    Shutdown_Mqtt_Service();
 }
 
 void MaxPlot::Init_GUI_SHOW()
 {
     Setup_Background();
 
+    Start_Mqtt_Service();
+
+    // Local consumers follow the live signal through shared memory instead of the broker
+    if (!shmRing.create(SHM_RING_NAME, MAX30102_CHANNELS, SHM_RING_CAPACITY, SAMPLE_RATE_HZ))
+    {
+        qDebug() << "Shared memory ring unavailable";
+    }
+
     Start_To_Read();
 
     End_All_Test();
@@ -131,42 +145,124 @@ void MaxPlot::Setup_Background()
 
 void MaxPlot::onStartButtonClicked()
 {
+    // Send ID
+    string userdata = qr->user_message;
+    size_t pos = userdata.find(',');
+    string sample_id = userdata.substr(0, pos);
+    string uuid = userdata.substr(pos + 1);
+
+    // Send Time
+    Start_TimeStamp = time(nullptr);
+    string Start_string = to_string(static_cast<long>(Start_TimeStamp));
+
+    source = Create_Frame_Source();
+    RecordingProfile profile = source->profile();
+
+    sessionData.clear();
+    uploader.begin(sample_id, uuid, Start_string, profile.sample_rate);
+
+    if (shmRing.channels() != profile.channels || shmRing.sampleRate() != profile.sample_rate)
+    {
+        if (!shmRing.create(SHM_RING_NAME, profile.channels, SHM_RING_CAPACITY, profile.sample_rate))
+        {
+            qDebug() << "Shared memory ring unavailable";
+        }
+    }
+
+    ChannelRoles roles = ChannelRoles::fromEnvironment(profile.channels);
+    const char *align = getenv(ALIGN_ENV);
+    const char *suppress = getenv(MOTION_SUPPRESS_ENV);
+    if (!pipeline.configure(profile.channels, profile.sample_rate, roles, align && atoi(align), suppress && atoi(suppress)))
+    {
+        qDebug() << "Signal pipeline unavailable";
+    }
+    referenceChannels = roles.referenceChannels();
+    flapChannels = roles.flapChannels();
+    nextVitalsNs = 0;
+    lastPerfusionUpdate = 0;
+    lastQualityUpdate = 0;
+    lastTransitUpdate = 0;
+    nextTransitNs = 0;
+    nextBeatsNs = 0;
+    beatsLogged = 0;
+    beatsPublished = 0;
+    motionPublished = 0;
+    const char *mqttMode = getenv(MQTT_MODE_ENV);
+    rawMqtt = !(mqttMode && strcmp(mqttMode, "beats") == 0);
+    readFinished = false;
+
+    // Raw counts for MQTT first, then the plot traces; both filtered down from one history
+    mqttOutput = plotOutput = -1;
+    if (liveRates.setup(2 * MQTT_CHANNELS + PLOT_TRACES, profile.sample_rate))
+    {
+        mqttOutput = liveRates.subscribe(MQTT_RATE_HZ, 0, 2 * MQTT_CHANNELS);
+        plotOutput = liveRates.subscribe(PLOT_RATE_HZ, 2 * MQTT_CHANNELS, PLOT_TRACES);
+        qDebug() << "Live rates: MQTT" << liveRates.rate(mqttOutput) << "Hz, plot" << liveRates.rate(plotOutput) << "Hz";
+    }
+
+    if (!recorder.open(RecordingWriter::pathFor(sample_id, Start_string), profile, sample_id, uuid, Start_TimeStamp))
+    {
+        qDebug() << "Session recording unavailable";
+    }
+    if (!beatLog.open(BeatLogWriter::pathFor(sample_id, Start_string), profile.channels, profile.sample_rate, sample_id, Start_TimeStamp))
+    {
+        qDebug() << "Beat log unavailable";
+    }
+
     Read_Data_Thread();
     Update_Plot_Thread();
     Mqtt_Thread();
 }
 
+// A recording or the generator can stand in for the sensors, e.g. to profile the pipeline without a patient
+FrameSource *MaxPlot::Create_Frame_Source()
+{
+    const char *replay = getenv(REPLAY_FILE_ENV);
+    if (replay && *replay)
+    {
+        const char *speed = getenv(REPLAY_SPEED_ENV);
+        return new ReplaySource(replay, speed ? atof(speed) : 1.0);
+    }
+
+    const char *synthetic = getenv(SYNTH_CHANNELS_ENV);
+    if (synthetic && *synthetic)
+        return new SyntheticSource(SyntheticConfig::fromEnvironment());
+
+    return new MAX30102("/dev/i2c-4");
+}
+
 void MaxPlot::Read_Data_Thread()
 {
-    max30102 = new MAX30102("/dev/i2c-4");
-    worker = new MaxDataWorker(nullptr, max30102);
+    worker = new MaxDataWorker(nullptr, source);
 
     workerThread = new QThread();
     worker->moveToThread(workerThread);
 
     connect(workerThread, &QThread::started, worker, &MaxDataWorker::doWork);
 
-    connect(max30102, &MAX30102::dataReady, this, &MaxPlot::handleDataReady);
+    connect(source, &FrameSource::dataReady, this, &MaxPlot::handleDataReady);
     connect(worker, &MaxDataWorker::finishRead, this, &MaxPlot::Http_Worker_Start);
     connect(workerThread, &QThread::finished, worker, &QObject::deleteLater);
 
-    qRegisterMetaType<MaxData>("MaxData");
+    qRegisterMetaType<MaxDataRef>("MaxDataRef");
 
     workerThread->start();
 }
 
 void MaxPlot::stop_Read_Thread()
 {
-    // To Do
-    max30102->Quit();
-    if (!max30102)
-        delete max30102;
+    if (!workerThread)
+        return;
 
+    // run() returns once the source quits; it is in use on the worker thread until then
+    source->Quit();
     workerThread->quit();
     workerThread->wait();
 
-    if (!workerThread)
-        delete workerThread;
+    delete source;
+    delete workerThread;
+    source = nullptr;
+    workerThread = nullptr;
 }
 
 void MaxPlot::Update_Plot_Thread()
@@ -183,21 +279,59 @@ void MaxPlot::Update_Plot_Thread()
     timer->start(33);
 }
 
-void MaxPlot::Mqtt_Thread()
+// The MQTT session lives as long as the window; connecting happens in the worker thread
+void MaxPlot::Start_Mqtt_Service()
 {
-    Mqtt_timer = new QTimer();
     mqttThread = new QThread();
     mqttWorker = new MQTTWorker(ADDRESS, CLIENTID, TOPIC, QOS, TIMEOUT);
     mqttWorker->moveToThread(mqttThread);
 
+    connect(mqttThread, &QThread::started, mqttWorker, &MQTTWorker::start);
     connect(this, &MaxPlot::sendMQTTMessage, mqttWorker, &MQTTWorker::publishMessage);
+    connect(this, &MaxPlot::sendMQTTSummary, mqttWorker, &MQTTWorker::publishSummary);
+    // stop() runs on the worker thread; the thread ends once it returns
+    connect(mqttWorker, &MQTTWorker::finished, mqttThread, &QThread::quit, Qt::DirectConnection);
+
     mqttThread->start();
 
-    Mqtt_timer->setInterval(33);
+    Mqtt_timer = new QTimer(this);
+    Mqtt_timer->setInterval(1000 / MQTT_RATE_HZ);
     connect(Mqtt_timer, &QTimer::timeout, this, &MaxPlot::Get_Mqtt_Message);
+}
+
+void MaxPlot::Shutdown_Mqtt_Service()
+{
+    if (!mqttThread)
+        return;
 
+    if (Mqtt_timer && Mqtt_timer->isActive())
+    {
+        Mqtt_timer->stop();
+    }
+
+    // Queued behind whatever the worker is doing, e.g. a connect attempt that
+    // only gives up after TIMEOUT, so the window does not wait for it
+    QMetaObject::invokeMethod(mqttWorker, "stop", Qt::QueuedConnection);
+
+    if (mqttThread->wait(MQTT_SHUTDOWN_WAIT_MS))
+    {
+        delete mqttWorker;
+        delete mqttThread;
+    }
+    else
+    {
+        // Still busy: both go away once stop() has run and the thread has ended
+        qDebug() << "MQTT worker still busy, leaving it to finish on its own";
+        connect(mqttThread, &QThread::finished, mqttWorker, &QObject::deleteLater);
+        connect(mqttThread, &QThread::finished, mqttThread, &QObject::deleteLater);
+    }
+    mqttWorker = nullptr;
+    mqttThread = nullptr;
+}
+
+void MaxPlot::Mqtt_Thread()
+{
     Mqtt_timer->start();
-    // connect(this, &MaxPlot::Finish_Mqtt, this, &MaxPlot::stop_Mqtt_Thread);
 }
 
 void MaxPlot::stop_Plot_Timer()
@@ -215,193 +349,395 @@ void MaxPlot::stop_Plot_Timer()
 
 void MaxPlot::stop_Mqtt_Thread()
 {
+    // Only the per-session publishing stops; the broker session is kept for the next patient
     if (Mqtt_timer && Mqtt_timer->isActive())
     {
         Mqtt_timer->stop();
     }
+}
 
-    mqttWorker->stop();
-    delete mqttWorker;
-
-    mqttThread->quit();
-    mqttThread->wait();
-    if (!mqttThread)
-        delete mqttThread;
+void MaxPlot::Http_Worker_Start()
+{
+    // Full blocks were already streamed during capture; only the tail and the commit are left
+    vector<SampleBlockRef> tail = sessionData.take(true);
+    for (size_t i = 0; i < tail.size(); i++)
+        uploader.append(tail[i]);
+    uploader.finish();
+    recorder.close();
+    pipeline.finish();
+    Publish_Motion();
+    Log_Beats();
+    beatLog.close();
+    readFinished = true;
 }
 
-void Send_Message(const std::string &Start_Unix, const int *Channel_ID, const int *Red_Data, const int *IR_Data, const std::string &sample_id, const std::string &uuid, const int fre)
+void MaxPlot::Get_Mqtt_Message()
 {
-    CURL *curl = curl_easy_init();
-    if (curl)
+    // The timer ticks at MQTT_RATE_HZ; whatever was decimated since the last tick goes out
+    const SignalQuality &quality = pipeline.signalQuality();
+    while (!Queue_Mqtt[7].empty())
     {
-        int Data_Size = 45 * 800;
-        json jsonData;
-        jsonData["Start_Unix"] = Start_Unix;
+        uint32_t red_temp[8] = {0}, ir_temp[8] = {0}, channel_temp[8] = {0};
 
-        jsonData["channel_id"] = std::vector<int>(Channel_ID, Channel_ID + Data_Size);
-        jsonData["data"]["ir"] = std::vector<int>(IR_Data, IR_Data + Data_Size);
-        jsonData["data"]["reds"] = std::vector<int>(Red_Data, Red_Data + Data_Size);
+        for (int i = 0; i < 8; i++)
+        {
+            red_temp[i] = Queue_Mqtt[i].front();
+            Queue_Mqtt[i].pop();
 
-        jsonData["sample_id"] = sample_id;
-        jsonData["user_uuid"] = uuid;
+            ir_temp[i] = Queue_Mqtt[i].front();
+            Queue_Mqtt[i].pop();
+            channel_temp[i] = i;
+        }
 
-        jsonData["frequency"] = fre;
+        QJsonArray redTempArray;
+        QJsonArray irTempArray;
+        QJsonArray channelArray;
+
+        for (int i = 0; i < 8; i++)
+        {
+            // Nothing worth sending from a channel without contact, nor at all in beats mode
+            if (!rawMqtt || quality.level(i) == SIGNAL_DEAD)
+                continue;
+            redTempArray.append(static_cast<int>(red_temp[i]));
+            irTempArray.append(static_cast<int>(ir_temp[i]));
+            channelArray.append(static_cast<int>(channel_temp[i]));
+        }
 
-        string jsonString = jsonData.dump();
+        // 构建 QJsonObject
+        QJsonObject payloadObj;
+        payloadObj.insert("channel", channelArray);
+        payloadObj.insert("ir", irTempArray);
+        payloadObj.insert("red", redTempArray);
 
-        std::string url = "http://sp.grifcc.top:8080/collect/data";
+        // 转换为 JSON 字符串
+        QJsonDocument doc(payloadObj);
+        QString payload = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
 
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_POST, 1L);
+        if (!channelArray.isEmpty())
+            emit sendMQTTMessage(payload);
+    }
 
-        struct curl_slist *headers = NULL;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    // The queue now keeps up with the frames and runs dry between them; the session is over once the reading is
+    if (readFinished)
+        emit Finish_ALL();
 
-        // POST DATA
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonString.c_str());
+    //{"channel":[0,1,2,3,4,5,6,7],"ir":[10,20,30,40,50,60,70,80],"red":[15,25,35,45,55,65,75,85]}
+}
 
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK)
-            std::cerr << "curl_easy_perform() 失败: " << curl_easy_strerror(res) << std::endl;
+void MaxPlot::onExitButtonClicked()
+{
+    exitButton->setEnabled(false);
 
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+    if (timer->isActive())
+    {
+        timer->stop();
     }
-    else
+    if (Mqtt_timer && Mqtt_timer->isActive())
     {
-        std::cerr << "curl_easy_init() 失败" << std::endl;
+        Mqtt_timer->stop();
     }
+
+    stop_Read_Thread();
+    stop_Plot_Timer();
+    stop_Mqtt_Thread();
+    Shutdown_Mqtt_Service();
+
+    close();
 }
 
-void MaxPlot::Http_Worker_Start()
+void MaxPlot::handleDataReady(const MaxDataRef &frame)
 {
-    // cout << "Collect data is:" << count_data << endl;
-
-    // Init HTTP
-    CURLcode res = curl_global_init(CURL_GLOBAL_DEFAULT);
-    if (res != CURLE_OK)
+    const MaxData &data = *frame;
+    int64_t timestamp_ns = data.timestamp_ns;
+    shmRing.publish(timestamp_ns, data.redData, data.irData);
+    if (recorder.isOpen())
+        recorder.append(timestamp_ns, data.redData, data.irData);
+
+    // The server places samples by position, so the upload gets every channel, dead or in motion;
+    // suppressing motion only affects the derived metrics and the plot
+    for (int i = 0; i < data.channels; i++)
+        sessionData.append(timestamp_ns, i, data.redData[i], data.irData[i]);
+
+    const PipelineFrame &filtered = pipeline.process(data);
+
+    // The quality goes along with each upload chunk as a tag
+    const SignalQuality &quality = pipeline.signalQuality();
+    for (int i = 0; i < data.channels; i++)
+        sessionData.rate(i, quality.level(i));
+
+    Publish_Vitals(filtered);
+    Publish_Perfusion(filtered);
+    Publish_Quality(filtered);
+    Publish_Transit(filtered);
+    Publish_Beats(filtered);
+    Publish_Motion();
+    Log_Beats();
+
+    // Closed blocks go to the uploader right away, without copying
+    vector<SampleBlockRef> full = sessionData.take(false);
+    for (size_t i = 0; i < full.size(); i++)
+        uploader.append(full[i]);
+
+    // MQTT frames carry the first eight channels; unused ones read 0
+    float liveFrame[2 * MQTT_CHANNELS + PLOT_TRACES];
+    for (int i = 0; i < MQTT_CHANNELS; i++)
     {
-        std::cout << "curl_global_init() 失败: " << curl_easy_strerror(res) << std::endl;
+        liveFrame[2 * i] = data.redData[i];
+        liveFrame[2 * i + 1] = data.irData[i];
     }
 
-    // Send ID
-    string userdata = qr->user_message;
-    size_t pos = userdata.find(',');
-    string sample_id = userdata.substr(0, pos);
-    string uuid = userdata.substr(pos + 1);
+    // The plot shows the pulse band: the middle trace is the reference group's mean,
+    // the other four are the first flap sites. Raw counts still go to MQTT, the recording and the upload
+    // Dead channels are left out of the mean and drawn as gaps, and so are channels in motion when suppressing it.
+    // Gaps go into the decimator as 0 and are drawn as gaps again on its output, so they do not widen by the filter length
+    const MotionDetector &motion = pipeline.motion();
+    bool hideMotion = pipeline.suppressesMotion();
+    float *trace = liveFrame + 2 * MQTT_CHANNELS;
+    double temp_red = 0, temp_ir = 0;
+    int live = 0;
+    for (size_t i = 0; i < referenceChannels.size(); i++)
+    {
+        if (quality.level(referenceChannels[i]) == SIGNAL_DEAD || (hideMotion && motion.active(referenceChannels[i])))
+            continue;
+        temp_red += filtered.redAc[referenceChannels[i]];
+        temp_ir += filtered.irAc[referenceChannels[i]];
+        live++;
+    }
+    trace[0] = live ? temp_red / live : 0.0f;
+    trace[1] = live ? temp_ir / live : 0.0f;
 
-    // Send Time
-    long ts_start = static_cast<long>(Start_TimeStamp);
-    string Start_string = to_string(ts_start);
+    bool flapUsed[4], flapDead[4];
+    for (size_t i = 0; i < 4; i++)
+    {
+        flapUsed[i] = i < flapChannels.size();
+        flapDead[i] = flapUsed[i] && (quality.level(flapChannels[i]) == SIGNAL_DEAD || (hideMotion && motion.active(flapChannels[i])));
+        trace[2 + 2 * i] = flapUsed[i] && !flapDead[i] ? filtered.redAc[flapChannels[i]] : 0.0f;
+        trace[3 + 2 * i] = flapUsed[i] && !flapDead[i] ? filtered.irAc[flapChannels[i]] : 0.0f;
+    }
 
-    std::thread sendThread(Send_Message, Start_string, channel_send_id, red_send_data, ir_send_data, sample_id, uuid, 100);
-    sendThread.detach();
-    curl_global_cleanup();
-}
+    liveRates.process(liveFrame);
 
-void MaxPlot::Get_Mqtt_Message()
-{
-    // To do ke cha jie
-    uint32_t red_temp[8] = {0}, ir_temp[8] = {0}, channel_temp[8] = {0};
+    if (mqttOutput >= 0 && liveRates.ready(mqttOutput))
+    {
+        const float *counts = liveRates.output(mqttOutput);
+        for (int i = 0; i < MQTT_CHANNELS; i++)
+        {
+            Queue_Mqtt[i].push(static_cast<uint32_t>(lround(max(counts[2 * i], 0.0f))));
+            Queue_Mqtt[i].push(static_cast<uint32_t>(lround(max(counts[2 * i + 1], 0.0f))));
+        }
+    }
 
-    for (int i = 0; i < 8; i++)
+    if (plotOutput >= 0 && liveRates.ready(plotOutput))
     {
-        red_temp[i] = Queue_Mqtt[i].front();
-        Queue_Mqtt[i].pop();
+        const float *traces = liveRates.output(plotOutput) + 2 * MQTT_CHANNELS;
+        redData_middle.append(live ? traces[0] : qQNaN());
+        irData_middle.append(live ? traces[1] : qQNaN());
+
+        QVector<double> *flapRed[4] = {&red0, &red1, &red2, &red3};
+        QVector<double> *flapIr[4] = {&ir0, &ir1, &ir2, &ir3};
+        for (size_t i = 0; i < 4; i++)
+        {
+            flapRed[i]->append(!flapUsed[i] ? 0.0 : flapDead[i] ? qQNaN() : traces[2 + 2 * i]);
+            flapIr[i]->append(!flapUsed[i] ? 0.0 : flapDead[i] ? qQNaN() : traces[3 + 2 * i]);
+        }
 
-        ir_temp[i] = Queue_Mqtt[i].front();
-        Queue_Mqtt[i].pop();
-        channel_temp[i] = i;
+        double elapsedTime = startTime.msecsTo(QDateTime::currentDateTime()) / 1000.0;
+        xData.append(elapsedTime);
     }
 
-    QJsonArray redTempArray;
-    QJsonArray irTempArray;
-    QJsonArray channelArray;
+    // Frames queued before the source was stopped still arrive
+    if (source)
+        source->frameHandled();
+}
 
-    for (int i = 0; i < 8; i++)
+// Once a second of frame time, so a replay at speed reports at the recorded cadence
+void MaxPlot::Publish_Vitals(const PipelineFrame &frame)
+{
+    if (frame.timestamp_ns < nextVitalsNs)
+        return;
+    nextVitalsNs = frame.timestamp_ns + VITALS_PUBLISH_NS;
+
+    const VitalsEstimator &vitals = pipeline.vitals();
+    const SignalQuality &quality = pipeline.signalQuality();
+    QJsonArray hrArray;
+    QJsonArray spo2Array;
+    QJsonArray validArray;
+    for (int i = 0; i < vitals.channels(); i++)
     {
-        redTempArray.append(static_cast<int>(red_temp[i]));
-        irTempArray.append(static_cast<int>(ir_temp[i]));
-        channelArray.append(static_cast<int>(channel_temp[i]));
+        const ChannelVitals &ch = vitals.channel(i);
+        bool valid = ch.valid && quality.level(i) == SIGNAL_GOOD;
+        hrArray.append(valid ? qRound(ch.heartRate * 10) / 10.0 : 0.0);
+        spo2Array.append(valid ? qRound(ch.spo2 * 10) / 10.0 : 0.0);
+        validArray.append(valid);
     }
 
-    // 构建 QJsonObject
     QJsonObject payloadObj;
-    payloadObj.insert("channel", channelArray);
-    payloadObj.insert("ir", irTempArray);
-    payloadObj.insert("red", redTempArray);
+    payloadObj.insert("t", static_cast<double>(frame.timestamp_ns / 1000000));
+    payloadObj.insert("hr", hrArray);
+    payloadObj.insert("spo2", spo2Array);
+    payloadObj.insert("valid", validArray);
 
-    // 转换为 JSON 字符串
-    QJsonDocument doc(payloadObj);
-    QString payload = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
+    emit sendMQTTSummary("vitals", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
+}
 
-    emit sendMQTTMessage(payload);
+// Each time the perfusion window moves on, i.e. once a second
+void MaxPlot::Publish_Perfusion(const PipelineFrame &frame)
+{
+    const PerfusionMonitor &perfusion = pipeline.perfusion();
+    if (perfusion.updates() == lastPerfusionUpdate)
+        return;
+    lastPerfusionUpdate = perfusion.updates();
+
+    QJsonArray piArray;
+    for (int i = 0; i < frame.channels; i++)
+        piArray.append(qRound(perfusion.perfusionIndex(i) * 100) / 100.0);
+
+    QJsonArray flapArray;
+    QJsonArray ratioArray;
+    for (size_t i = 0; i < flapChannels.size(); i++)
+    {
+        flapArray.append(flapChannels[i]);
+        ratioArray.append(qRound(perfusion.ratio(flapChannels[i]) * 100) / 100.0);
+    }
 
-    if (Queue_Mqtt[7].size() == 0)
-        emit Finish_ALL();
+    QJsonObject payloadObj;
+    payloadObj.insert("t", static_cast<double>(frame.timestamp_ns / 1000000));
+    payloadObj.insert("pi", piArray);
+    payloadObj.insert("ref", qRound(perfusion.referenceIndex() * 100) / 100.0);
+    payloadObj.insert("flap", flapArray);
+    payloadObj.insert("ratio", ratioArray);
 
-    //{"channel":[0,1,2,3,4,5,6,7],"ir":[10,20,30,40,50,60,70,80],"red":[15,25,35,45,55,65,75,85]}
+    emit sendMQTTSummary("perfusion", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
 }
 
-void MaxPlot::onExitButtonClicked()
+// Signal quality per channel, once per quality block
+void MaxPlot::Publish_Quality(const PipelineFrame &frame)
 {
-    exitButton->setEnabled(false);
-
-    if (timer->isActive())
-    {
-        timer->stop();
-    }
-    if (Mqtt_timer && Mqtt_timer->isActive())
+    const SignalQuality &quality = pipeline.signalQuality();
+    if (quality.updates() == lastQualityUpdate)
+        return;
+    lastQualityUpdate = quality.updates();
+
+    QJsonArray levelArray;
+    QJsonArray snrArray;
+    QJsonArray clipArray;
+    QJsonArray rateArray;
+    for (int i = 0; i < frame.channels; i++)
     {
-        Mqtt_timer->stop();
+        levelArray.append(static_cast<int>(quality.level(i)));
+        snrArray.append(qRound(quality.peakToNoise(i) * 10) / 10.0);
+        clipArray.append(qRound(quality.clipping(i) * 100) / 100.0);
+        rateArray.append(qRound(quality.spectralRate(i) * 10) / 10.0);
     }
 
-    stop_Read_Thread();
-    stop_Plot_Timer();
-    stop_Mqtt_Thread();
+    QJsonObject payloadObj;
+    payloadObj.insert("t", static_cast<double>(frame.timestamp_ns / 1000000));
+    payloadObj.insert("level", levelArray);
+    payloadObj.insert("snr", snrArray);
+    payloadObj.insert("clip", clipArray);
+    payloadObj.insert("fhr", rateArray);
 
-    close();
+    emit sendMQTTSummary("quality", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
 }
 
-void MaxPlot::handleDataReady(const MaxData &data)
+// Transit times of the flap sites, at most once a second and only after new beats
+void MaxPlot::Publish_Transit(const PipelineFrame &frame)
 {
-    uint32_t temp_red = 0, temp_ir = 0;
-    for (int i = 0; i < 8; i++)
+    const PulseTransit &transit = pipeline.transit();
+    if (transit.updates() == lastTransitUpdate || frame.timestamp_ns < nextTransitNs)
+        return;
+    lastTransitUpdate = transit.updates();
+    nextTransitNs = frame.timestamp_ns + VITALS_PUBLISH_NS;
+
+    QJsonArray flapArray;
+    QJsonArray pttArray;
+    QJsonArray simArray;
+    for (size_t i = 0; i < transit.flapChannels().size(); i++)
     {
-        Queue_Mqtt[i].push(data.redData[i]);
-        Queue_Mqtt[i].push(data.irData[i]);
-
-        channel_send_id[count_data] = i;
-        red_send_data[count_data] = data.redData[i];
-        red_send_data[count_data++] = data.irData[i];
-        if (i == 0 || i == 2 || i == 4 || i == 6)
-        {
-            temp_red += data.redData[i];
-            temp_ir += data.irData[i];
-        }
+        const ChannelTransit &ch = transit.channel(transit.flapChannels()[i]);
+        flapArray.append(transit.flapChannels()[i]);
+        pttArray.append(qRound(ch.averageMs * 10) / 10.0);
+        simArray.append(qRound(ch.similarity * 100) / 100.0);
     }
 
-    temp_red /= 4;
-    temp_ir /= 4;
+    QJsonObject payloadObj;
+    payloadObj.insert("t", static_cast<double>(frame.timestamp_ns / 1000000));
+    payloadObj.insert("flap", flapArray);
+    payloadObj.insert("ptt", pttArray);
+    payloadObj.insert("sim", simArray);
+    payloadObj.insert("aligned", pipeline.aligned());
+
+    emit sendMQTTSummary("transit", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
+}
 
-    redData_middle.append(static_cast<double>(temp_red));
-    irData_middle.append(static_cast<double>(temp_ir));
+// Beats completed in the last second, one array per beat:
+// [channel, onset ms, duration ms, rise ms, amplitude, perfusion %, variability ms, flags]
+void MaxPlot::Publish_Beats(const PipelineFrame &frame)
+{
+    const BeatFeatures &beats = pipeline.beats();
+    if (frame.timestamp_ns < nextBeatsNs || beatsPublished == beats.produced())
+        return;
+    nextBeatsNs = frame.timestamp_ns + VITALS_PUBLISH_NS;
 
-    red0.append(static_cast<double>(data.redData[1]));
-    ir0.append(static_cast<double>(data.irData[1]));
+    QJsonArray beatArray;
+    for (uint64_t seq = max(beatsPublished, beats.oldest()); seq < beats.produced(); seq++)
+    {
+        const BeatRecord &b = beats.record(seq);
+        QJsonArray item;
+        item.append(b.channel);
+        item.append(static_cast<double>(b.onset_ns / 1000000));
+        item.append(b.duration_ms);
+        item.append(b.rise_ms);
+        item.append(qRound(b.amplitude));
+        item.append(qRound(b.perfusion * 1000) / 1000.0);
+        item.append(b.variability_ms);
+        item.append(b.flags);
+        beatArray.append(item);
+    }
+    beatsPublished = beats.produced();
 
-    red1.append(static_cast<double>(data.redData[3]));
-    ir1.append(static_cast<double>(data.irData[3]));
+    QJsonObject payloadObj;
+    payloadObj.insert("t", static_cast<double>(frame.timestamp_ns / 1000000));
+    payloadObj.insert("beats", beatArray);
 
-    red2.append(static_cast<double>(data.redData[5]));
-    ir2.append(static_cast<double>(data.irData[5]));
+    emit sendMQTTSummary("beats", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
+}
 
-    red3.append(static_cast<double>(data.redData[7]));
-    ir3.append(static_cast<double>(data.irData[7]));
+// Each motion interval once it is over, so the server can drop or mark it without scanning the session
+void MaxPlot::Publish_Motion()
+{
+    const MotionDetector &motion = pipeline.motion();
+    for (uint64_t seq = max(motionPublished, motion.oldest()); seq < motion.produced(); seq++)
+    {
+        const MotionInterval &m = motion.interval(seq);
+        QJsonArray channelArray;
+        for (size_t ch = 0; ch < m.channels.size(); ch++)
+        {
+            if (m.channels.test(ch))
+                channelArray.append(static_cast<int>(ch));
+        }
+        QJsonObject payloadObj;
+        payloadObj.insert("start", static_cast<double>(m.start_ns / 1000000));
+        payloadObj.insert("end", static_cast<double>(m.end_ns / 1000000));
+        payloadObj.insert("channels", channelArray);
+        payloadObj.insert("peak", qRound(m.peak * 10) / 10.0);
+        payloadObj.insert("suppressed", pipeline.suppressesMotion());
+
+        emit sendMQTTSummary("motion", QString::fromUtf8(QJsonDocument(payloadObj).toJson(QJsonDocument::Compact)));
+    }
+    motionPublished = motion.produced();
+}
 
-    double elapsedTime = startTime.msecsTo(QDateTime::currentDateTime()) / 1000.0;
-    xData.append(elapsedTime);
+// Completed beats go to the beat log as they come, records older than the stage's queue are lost
+void MaxPlot::Log_Beats()
+{
+    const BeatFeatures &beats = pipeline.beats();
+    for (uint64_t seq = max(beatsLogged, beats.oldest()); seq < beats.produced(); seq++)
+    {
+        if (beatLog.isOpen())
+            beatLog.append(beats.record(seq));
+    }
+    beatsLogged = beats.produced();
 }
 
 void MaxPlot::setupPlot()
@@ -441,7 +777,7 @@ void MaxPlot::setupPlot()
     plot->yAxis->setLabel("Amplitude");
 
     plot->xAxis->setRange(0, windowSize);
-    plot->yAxis->setRange(0, 500000);
+    plot->yAxis->setRange(-2000, 2000);
 
     plot->legend->setVisible(true);
 
@@ -577,6 +913,24 @@ void MaxPlot::updatePlot()
             plot->xAxis->setRange(elapsedTime - windowSize, elapsedTime);
         }
     }
+
+    // AC amplitude differs a lot between sites, so follow what is on screen unless the user is browsing
+    if (!isView)
+    {
+        bool found = false;
+        QCPRange range;
+        for (int i = 0; i < plot->graphCount(); i++)
+        {
+            bool graphFound = false;
+            QCPRange r = plot->graph(i)->getValueRange(graphFound, QCP::sdBoth, plot->xAxis->range());
+            if (!graphFound)
+                continue;
+            range = found ? QCPRange(qMin(range.lower, r.lower), qMax(range.upper, r.upper)) : r;
+            found = true;
+        }
+        if (found && range.size() > 0)
+            plot->yAxis->setRange(range.lower - 0.1 * range.size(), range.upper + 0.1 * range.size());
+    }
     plot->replot();
 }
 
@@ -16,6 +16,8 @@
 #include <QTimer>
 #include <QPushButton>
 #include "max30102.h"
+#include "ReplaySource.h"
+#include "SyntheticSource.h"
 #include "QRCodeGenerator.h"
 #include <ctime>
 #include <QTimer>
@@ -24,6 +26,13 @@
 #include <QThread>
 #include "MaxDataWorker.h"
 #include "MQTTWorker.h"
+#include "ShmRing.h"
+#include "SessionUploader.h"
+#include "SessionBuffer.h"
+#include "SignalPipeline.h"
+#include "RecordingFile.h"
+#include "BeatLog.h"
+#include "MultiRateDecimator.h"
 #include <queue>
 #include <QJsonObject>
 #include <QJsonDocument>
@@ -33,10 +42,24 @@
 #define TOPIC "sensor/data"
 #define QOS 1
 #define TIMEOUT 10000L
+#define MQTT_SHUTDOWN_WAIT_MS 3000 // a connect attempt in progress can take TIMEOUT
+
+#define SHM_RING_CAPACITY 4096
+#define SAMPLE_RATE_HZ MAX30102_SAMPLE_RATE_HZ
+#define VITALS_PUBLISH_NS 1000000000LL
+
+// COLLECT_MQTT_MODE=beats sends only the summaries and the beat stream, no raw frames
+#define MQTT_MODE_ENV "COLLECT_MQTT_MODE"
+
+// The plot and the raw MQTT frames run at these rates, whatever the sensors do;
+// the recording, the shared memory ring and the upload keep every frame
+#define PLOT_RATE_HZ 60
+#define MQTT_RATE_HZ 50
+#define MQTT_CHANNELS 8 // red and ir of the first eight channels per MQTT frame
+#define PLOT_TRACES 10
 
 
 using namespace std;
-const int DATA_NUM = 200005;
 
 class MaxPlot : public QMainWindow
 {
@@ -49,6 +72,7 @@ public:
 signals:
     void windowClosed();
     void sendMQTTMessage(const QString &message);
+    void sendMQTTSummary(const QString &subtopic, const QString &message);
     void Finish_ALL();
 
 protected:
@@ -88,11 +112,19 @@ public:
     void setupPlot();
     void setupSlider();
     void setupGestures();
-    void handleDataReady(const MaxData &data);
+    void handleDataReady(const MaxDataRef &frame);
+    void Publish_Vitals(const PipelineFrame &frame);
+    void Publish_Perfusion(const PipelineFrame &frame);
+    void Publish_Quality(const PipelineFrame &frame);
+    void Publish_Transit(const PipelineFrame &frame);
+    void Publish_Beats(const PipelineFrame &frame);
+    void Publish_Motion();
+    void Log_Beats();
     void Start_To_Read();
+    FrameSource *Create_Frame_Source();
     void End_All_Test();
-
-    int red_send_data[DATA_NUM], ir_send_data[DATA_NUM], channel_send_id[DATA_NUM];
+    void Start_Mqtt_Service();
+    void Shutdown_Mqtt_Service();
 
     QCustomPlot *plot;
     QSlider *slider;
@@ -124,14 +156,35 @@ public:
     QRCodeGenerator *qr;
     time_t Start_TimeStamp;
     time_t End_TimeStamp;
-    uint32_t count_data = 0;
+    SessionBuffer sessionData;
+    SignalPipeline pipeline;
+    int64_t nextVitalsNs = 0;
+    uint32_t lastPerfusionUpdate = 0;
+    uint32_t lastQualityUpdate = 0;
+    uint32_t lastTransitUpdate = 0;
+    int64_t nextTransitNs = 0;
+    int64_t nextBeatsNs = 0;
+    uint64_t beatsLogged = 0;
+    uint64_t beatsPublished = 0;
+    uint64_t motionPublished = 0;
+    bool rawMqtt = true;
+    vector<int> referenceChannels;
+    vector<int> flapChannels;
+    RecordingWriter recorder;
+    BeatLogWriter beatLog;
+    MultiRateDecimator liveRates;
+    int mqttOutput = -1;
+    int plotOutput = -1;
+    bool readFinished = false;
 
     MaxDataWorker *worker;
-    QThread *workerThread;
+    QThread *workerThread = nullptr;
     QThread *timerThread;
-    QThread *mqttThread;
-    MQTTWorker *mqttWorker;
-    MAX30102 *max30102;
+    QThread *mqttThread = nullptr;
+    MQTTWorker *mqttWorker = nullptr;
+    FrameSource *source = nullptr;
+    ShmRingWriter shmRing;
+    SessionUploader &uploader; // process-wide, outlives every MaxPlot
 };
 
 #endif // MAINWINDOW_H
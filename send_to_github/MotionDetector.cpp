@@ -0,0 +1,122 @@
+#include "MotionDetector.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+MotionDetector::MotionDetector()
+{
+    configure(0, 1);
+}
+
+void MotionDetector::configure(int channels, double sampleRate)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    fastAlpha = static_cast<float>(1 - exp(-1 / (sampleRate * MOTION_FAST_SECONDS)));
+    slowAlpha = static_cast<float>(1 - exp(-1 / (sampleRate * MOTION_SLOW_SECONDS)));
+    dcAlpha = static_cast<float>(1 - exp(-1 / (sampleRate * MOTION_DC_SECONDS)));
+    holdNs = static_cast<int64_t>(MOTION_HOLD_SECONDS * 1e9);
+    warmupNs = static_cast<int64_t>(MOTION_WARMUP_SECONDS * 1e9);
+    firstNs = 0;
+    lastNs = 0;
+
+    memset(lastAc, 0, sizeof(lastAc));
+    memset(fast, 0, sizeof(fast));
+    memset(slow, 0, sizeof(slow));
+    memset(dcLevel, 0, sizeof(dcLevel));
+    memset(ratio, 0, sizeof(ratio));
+    memset(holdUntil, 0, sizeof(holdUntil));
+    intervalOpen = false;
+    current = MotionInterval();
+    total = 0;
+}
+
+void MotionDetector::process(PipelineFrame &frame, bool suppress)
+{
+    int64_t now = frame.timestamp_ns;
+    if (firstNs == 0)
+    {
+        firstNs = now;
+        memcpy(lastAc, frame.irAc, count * sizeof(float));
+        memcpy(dcLevel, frame.irDc, count * sizeof(float));
+    }
+    lastNs = now;
+    bool warm = now - firstNs >= warmupNs;
+
+    // Derivative energy, across all channels at once
+    for (int ch = 0; ch < count; ch++)
+    {
+        float d = frame.irAc[ch] - lastAc[ch];
+        lastAc[ch] = frame.irAc[ch];
+        fast[ch] += (d * d - fast[ch]) * fastAlpha;
+        ratio[ch] = slow[ch] > 0 ? fast[ch] / slow[ch] : 0;
+    }
+
+    // How many of the channels with contact see it at the same time
+    int live = 0, excess = 0;
+    for (int ch = 0; ch < count; ch++)
+    {
+        if (frame.quality[ch] & QUALITY_NO_CONTACT)
+            continue;
+        live++;
+        if (ratio[ch] > MOTION_ENERGY_LOW)
+            excess++;
+    }
+    bool together = live >= 2 && 2 * excess >= live;
+
+    bool any = false;
+    for (int ch = 0; ch < count; ch++)
+    {
+        bool contact = !(frame.quality[ch] & QUALITY_NO_CONTACT);
+        float dc = frame.irDc[ch];
+        bool jump = dcLevel[ch] > 0 && fabs(dc - dcLevel[ch]) > MOTION_DC_JUMP * dcLevel[ch];
+        dcLevel[ch] += (dc - dcLevel[ch]) * dcAlpha;
+
+        if (warm && contact && (ratio[ch] > MOTION_ENERGY_HIGH || (together && ratio[ch] > MOTION_ENERGY_LOW) || jump))
+        {
+            holdUntil[ch] = now + holdNs;
+            current.channels.set(ch);
+        }
+
+        bool moving = holdUntil[ch] > now;
+        if (moving)
+        {
+            any = true;
+            current.peak = max(current.peak, ratio[ch]);
+            if (suppress)
+                frame.quality[ch] |= QUALITY_MOTION;
+        }
+        else if (contact)
+        {
+            // The rest level is learnt quickly at first, then slowly and never from motion
+            slow[ch] += (fast[ch] - slow[ch]) * (warm ? slowAlpha : fastAlpha);
+        }
+    }
+
+    if (any && !intervalOpen)
+    {
+        intervalOpen = true;
+        current.start_ns = now;
+    }
+    else if (!any && intervalOpen)
+    {
+        closeInterval(now);
+    }
+}
+
+void MotionDetector::finish()
+{
+    if (intervalOpen)
+        closeInterval(lastNs);
+}
+
+void MotionDetector::closeInterval(int64_t end_ns)
+{
+    current.end_ns = end_ns;
+    queue[total % MOTION_QUEUE] = current;
+    total++;
+    intervalOpen = false;
+    current = MotionInterval();
+}
@@ -0,0 +1,87 @@
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <stdint.h>
+#include <bitset>
+#include "DspCommon.h"
+
+// COLLECT_SUPPRESS_MOTION=1 keeps samples in motion out of the derived metrics
+#define MOTION_SUPPRESS_ENV "COLLECT_SUPPRESS_MOTION"
+#define MOTION_FAST_SECONDS 0.5   // derivative energy now; at least a beat, so the upstroke alone does not count
+#define MOTION_SLOW_SECONDS 10.0  // derivative energy at rest, follows only while there is no motion
+#define MOTION_WARMUP_SECONDS 2.0 // the rest level is learnt first, nothing is flagged meanwhile
+#define MOTION_ENERGY_LOW 4.0     // over the rest level, enough when most channels see it at once
+#define MOTION_ENERGY_HIGH 12.0   // over the rest level, enough on one channel alone
+#define MOTION_DC_JUMP 0.03       // ir DC moving off its recent level by this share
+#define MOTION_DC_SECONDS 2.0
+#define MOTION_HOLD_SECONDS 1.0   // flagged on after the last trigger, while the filters settle
+#define MOTION_QUEUE 64
+
+struct PipelineFrame;
+
+// A stretch of frames in which at least one channel was in motion
+struct MotionInterval
+{
+    int64_t start_ns;
+    int64_t end_ns;
+    std::bitset<DSP_MAX_CHANNELS> channels; // that were in motion at some point of it
+    float peak;                             // highest derivative energy over the rest level
+};
+
+// Streaming motion artefact detector over the filtered channels.
+// Three signs of movement, checked every frame:
+//  - derivative energy of the ir pulse band, smoothed over MOTION_FAST_SECONDS,
+//    far above the channel's own level at rest;
+//  - the same, less far, on at least half of the channels with contact at
+//    the same time: the probe or the patient moved, not one site;
+//  - ir DC leaving its recent level, the probe shifting on the skin.
+// A channel stays in motion MOTION_HOLD_SECONDS past its last trigger.
+// Stretches with any channel in motion are queued as intervals, read the
+// same way as the beat records; finish() queues one still open when the
+// session ends. All state is per channel and the per-frame
+// work is a handful of multiply-adds on each.
+class MotionDetector
+{
+public:
+    MotionDetector();
+
+    void configure(int channels, double sampleRate);
+
+    // Marks out.quality with QUALITY_MOTION where suppress is set
+    void process(PipelineFrame &frame, bool suppress);
+
+    // End of the session: closes the interval in progress, if any, at the last frame
+    void finish();
+
+    bool active(int ch) const { return holdUntil[ch] > lastNs; }
+    float energy(int ch) const { return ratio[ch]; } // over the rest level
+    bool anyActive() const { return intervalOpen; }
+
+    uint64_t produced() const { return total; }
+    uint64_t oldest() const { return total > MOTION_QUEUE ? total - MOTION_QUEUE : 0; }
+    const MotionInterval &interval(uint64_t seq) const { return queue[seq % MOTION_QUEUE]; }
+
+private:
+    void closeInterval(int64_t end_ns);
+
+    int count;
+    float fastAlpha, slowAlpha, dcAlpha;
+    int64_t holdNs;
+    int64_t warmupNs;
+    int64_t firstNs;
+    int64_t lastNs;
+
+    float lastAc[DSP_MAX_CHANNELS];
+    float fast[DSP_MAX_CHANNELS];
+    float slow[DSP_MAX_CHANNELS];
+    float dcLevel[DSP_MAX_CHANNELS];
+    float ratio[DSP_MAX_CHANNELS];
+    int64_t holdUntil[DSP_MAX_CHANNELS];
+
+    bool intervalOpen;
+    MotionInterval current;
+    MotionInterval queue[MOTION_QUEUE];
+    uint64_t total;
+};
+
+#endif // MOTIONDETECTOR_H
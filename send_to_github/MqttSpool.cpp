@@ -0,0 +1,433 @@
+#include "MqttSpool.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+using namespace std;
+
+static const size_t RECORD_HEADER = 8;
+static const uint32_t MAX_RECORD = 16 << 20;
+
+static uint32_t fnv1a(const char *data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool make_dirs(const string &path)
+{
+    string current;
+    size_t pos = 0;
+    while (pos != string::npos)
+    {
+        pos = path.find('/', pos + 1);
+        current = path.substr(0, pos);
+        if (current.empty())
+            continue;
+        if (mkdir(current.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            perror("Failed to create spool directory");
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t file_size(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return 0;
+    return static_cast<uint64_t>(st.st_size);
+}
+
+MqttSpool::MqttSpool(const string &dir, size_t segmentBytes, size_t maxBytes, int syncEvery)
+    : dir(dir), segmentBytes(segmentBytes), maxBytes(maxBytes), syncEvery(syncEvery),
+      writeId(0), writeOffset(0), writeFd(-1),
+      readId(0), readOffset(0), readFd(-1), peekedBytes(0),
+      totalBytes(0), unsynced(0), unsavedPops(0), lastSync(0), dropped(0), opened(false)
+{
+}
+
+MqttSpool::~MqttSpool()
+{
+    close();
+}
+
+string MqttSpool::segmentPath(uint64_t id) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%010llu.seg", static_cast<unsigned long long>(id));
+    return dir + name;
+}
+
+bool MqttSpool::open()
+{
+    if (opened)
+        return true;
+    if (!make_dirs(dir))
+        return false;
+
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+    {
+        perror("Failed to open spool directory");
+        return false;
+    }
+
+    vector<uint64_t> found;
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        const char *name = entry->d_name;
+        size_t len = strlen(name);
+        if (len > 4 && strcmp(name + len - 4, ".seg") == 0)
+            found.push_back(strtoull(name, NULL, 10));
+    }
+    closedir(d);
+    sort(found.begin(), found.end());
+
+    uint64_t cursorId = 0, cursorOffset = 0;
+    loadCursor(cursorId, cursorOffset);
+
+    segments.clear();
+    totalBytes = 0;
+    for (size_t i = 0; i < found.size(); i++)
+    {
+        // Segments before the cursor were fully acknowledged already
+        if (found[i] < cursorId)
+        {
+            unlink(segmentPath(found[i]).c_str());
+            continue;
+        }
+        segments.push_back(found[i]);
+    }
+
+    if (segments.empty())
+    {
+        segments.push_back(cursorId + 1);
+        cursorOffset = 0;
+    }
+    else
+    {
+        recoverTail(segments.back());
+    }
+
+    readId = segments.front();
+    readOffset = (readId == cursorId) ? cursorOffset : 0;
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        struct stat st;
+        if (stat(segmentPath(segments[i]).c_str(), &st) == 0)
+            totalBytes += st.st_size;
+    }
+    totalBytes = totalBytes > readOffset ? totalBytes - readOffset : 0;
+
+    if (!openWriteSegment(segments.back()))
+        return false;
+
+    lastSync = time(nullptr);
+    opened = true;
+
+    if (totalBytes > 0)
+        cout << "MQTT spool holds " << totalBytes << " bytes from a previous run" << endl;
+    return true;
+}
+
+void MqttSpool::close()
+{
+    if (!opened)
+        return;
+    sync();
+    if (writeFd >= 0)
+        ::close(writeFd);
+    if (readFd >= 0)
+        ::close(readFd);
+    writeFd = readFd = -1;
+    opened = false;
+}
+
+bool MqttSpool::openWriteSegment(uint64_t id)
+{
+    if (writeFd >= 0)
+    {
+        fdatasync(writeFd);
+        ::close(writeFd);
+    }
+
+    writeFd = ::open(segmentPath(id).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (writeFd < 0)
+    {
+        perror("Failed to open spool segment");
+        return false;
+    }
+    writeId = id;
+    writeOffset = file_size(writeFd);
+    return true;
+}
+
+bool MqttSpool::openReadSegment(uint64_t id)
+{
+    if (readFd >= 0)
+        ::close(readFd);
+
+    readFd = ::open(segmentPath(id).c_str(), O_RDONLY);
+    if (readFd < 0)
+    {
+        perror("Failed to read spool segment");
+        return false;
+    }
+    readId = id;
+    return true;
+}
+
+void MqttSpool::recoverTail(uint64_t id)
+{
+    // A crash can leave a half written record at the end of the last segment
+    int fd = ::open(segmentPath(id).c_str(), O_RDWR);
+    if (fd < 0)
+        return;
+
+    uint64_t size = file_size(fd);
+    uint64_t offset = 0;
+    vector<char> payload;
+    while (offset + RECORD_HEADER <= size)
+    {
+        uint32_t header[2];
+        if (pread(fd, header, RECORD_HEADER, offset) != (ssize_t)RECORD_HEADER)
+            break;
+        if (header[0] > MAX_RECORD || offset + RECORD_HEADER + header[0] > size)
+            break;
+        payload.resize(header[0]);
+        if (header[0] > 0 && pread(fd, payload.data(), header[0], offset + RECORD_HEADER) != (ssize_t)header[0])
+            break;
+        if (fnv1a(payload.data(), header[0]) != header[1])
+            break;
+        offset += RECORD_HEADER + header[0];
+    }
+
+    if (offset < size)
+    {
+        cerr << "MQTT spool: dropping " << (size - offset) << " torn bytes from segment " << id << endl;
+        if (ftruncate(fd, offset) != 0)
+            perror("ftruncate");
+    }
+    ::close(fd);
+}
+
+bool MqttSpool::append(const char *data, size_t len)
+{
+    if (!opened)
+        return false;
+
+    size_t recordLen = RECORD_HEADER + len;
+    if (len > MAX_RECORD)
+        return false;
+
+    if (writeOffset > 0 && writeOffset + recordLen > segmentBytes)
+    {
+        if (!openWriteSegment(writeId + 1))
+            return false;
+        segments.push_back(writeId);
+    }
+
+    while (totalBytes + recordLen > maxBytes && segments.size() > 1)
+        dropOldestSegment();
+
+    if (totalBytes + recordLen > maxBytes)
+    {
+        dropped += recordLen;
+        return false;
+    }
+
+    uint32_t header[2] = {static_cast<uint32_t>(len), fnv1a(data, len)};
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = RECORD_HEADER;
+    iov[1].iov_base = const_cast<char *>(data);
+    iov[1].iov_len = len;
+
+    ssize_t written = writev(writeFd, iov, 2);
+    if (written != (ssize_t)recordLen)
+    {
+        perror("Failed to write spool record");
+        return false;
+    }
+
+    writeOffset += recordLen;
+    totalBytes += recordLen;
+
+    // Batch fsync by record count and by time so a quiet tail is not left unsynced for long
+    if (++unsynced >= syncEvery || time(nullptr) - lastSync >= 1)
+        sync();
+    return true;
+}
+
+void MqttSpool::dropOldestSegment()
+{
+    uint64_t id = segments.front();
+    struct stat st;
+    uint64_t size = 0;
+    if (stat(segmentPath(id).c_str(), &st) == 0)
+        size = st.st_size;
+
+    uint64_t lost = (id == readId) ? (size > readOffset ? size - readOffset : 0) : size;
+    totalBytes = totalBytes > lost ? totalBytes - lost : 0;
+    dropped += lost;
+
+    if (id == readId && readFd >= 0)
+    {
+        ::close(readFd);
+        readFd = -1;
+    }
+    unlink(segmentPath(id).c_str());
+    segments.pop_front();
+
+    readId = segments.front();
+    readOffset = 0;
+    unpeek();
+    saveCursor();
+
+    cerr << "MQTT spool full, dropped " << lost << " bytes of oldest data" << endl;
+}
+
+bool MqttSpool::peek(string &payload)
+{
+    if (!opened)
+        return false;
+
+    while (true)
+    {
+        uint64_t offset = readOffset + peekedBytes;
+        if (readId == writeId && offset >= writeOffset)
+            return false;
+
+        if (readFd < 0 && !openReadSegment(readId))
+            return false;
+
+        uint64_t size = (readId == writeId) ? writeOffset : file_size(readFd);
+        uint32_t header[2];
+        bool valid = offset + RECORD_HEADER <= size &&
+                     pread(readFd, header, RECORD_HEADER, offset) == (ssize_t)RECORD_HEADER &&
+                     header[0] <= MAX_RECORD && offset + RECORD_HEADER + header[0] <= size;
+
+        if (valid)
+        {
+            payload.resize(header[0]);
+            valid = header[0] == 0 || pread(readFd, &payload[0], header[0], offset + RECORD_HEADER) == (ssize_t)header[0];
+            valid = valid && fnv1a(payload.data(), header[0]) == header[1];
+        }
+
+        if (valid)
+        {
+            peeked.push_back(RECORD_HEADER + header[0]);
+            peekedBytes += peeked.back();
+            return true;
+        }
+
+        // Segments are only skipped or dropped from the acknowledged position
+        if (!peeked.empty())
+            return false;
+
+        if (readId == writeId)
+        {
+            cerr << "MQTT spool: unreadable record in active segment, skipping to end" << endl;
+            totalBytes -= min<uint64_t>(totalBytes, writeOffset - readOffset);
+            readOffset = writeOffset;
+            return false;
+        }
+
+        // Segment exhausted (or its tail is unreadable): move to the next one
+        totalBytes -= min<uint64_t>(totalBytes, size > readOffset ? size - readOffset : 0);
+        ::close(readFd);
+        readFd = -1;
+        unlink(segmentPath(readId).c_str());
+        segments.pop_front();
+        readId = segments.front();
+        readOffset = 0;
+        saveCursor();
+    }
+}
+
+void MqttSpool::pop()
+{
+    if (peeked.empty())
+        return;
+
+    uint64_t length = peeked.front();
+    peeked.pop_front();
+    peekedBytes -= length;
+    readOffset += length;
+    totalBytes -= min<uint64_t>(totalBytes, length);
+
+    // Live frames pass through here too, so the cursor is not saved on every drain;
+    // a crash sends at most syncEvery acknowledged records again
+    if (++unsavedPops >= syncEvery)
+        saveCursor();
+}
+
+void MqttSpool::unpeek()
+{
+    peeked.clear();
+    peekedBytes = 0;
+}
+
+void MqttSpool::sync()
+{
+    if (writeFd >= 0)
+        fdatasync(writeFd);
+    saveCursor();
+    unsynced = 0;
+    lastSync = time(nullptr);
+}
+
+bool MqttSpool::empty() const
+{
+    return totalBytes == 0;
+}
+
+void MqttSpool::saveCursor()
+{
+    string path = dir + "/cursor";
+    string tmp = path + ".tmp";
+
+    FILE *fp = fopen(tmp.c_str(), "w");
+    if (!fp)
+        return;
+    fprintf(fp, "%llu %llu\n", static_cast<unsigned long long>(readId), static_cast<unsigned long long>(readOffset));
+    fflush(fp);
+    fdatasync(fileno(fp));
+    fclose(fp);
+    rename(tmp.c_str(), path.c_str());
+    unsavedPops = 0;
+}
+
+void MqttSpool::loadCursor(uint64_t &id, uint64_t &offset)
+{
+    string path = dir + "/cursor";
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+        return;
+    unsigned long long i = 0, o = 0;
+    if (fscanf(fp, "%llu %llu", &i, &o) == 2)
+    {
+        id = i;
+        offset = o;
+    }
+    fclose(fp);
+}
@@ -0,0 +1,79 @@
+#ifndef MQTTSPOOL_H
+#define MQTTSPOOL_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <ctime>
+
+// Append-only on-disk queue for MQTT payloads that could not be published.
+// Records live in numbered segment files under one directory:
+//   [uint32 length][uint32 fnv1a checksum][payload]
+// A small "cursor" file remembers the first unacknowledged record so a
+// restart replays only what the broker has not seen yet (give or take the
+// last syncEvery acknowledgements). Several records can be peeked ahead of
+// the acknowledged ones, so a sender can keep a window of them in flight.
+class MqttSpool
+{
+public:
+    MqttSpool(const std::string &dir, size_t segmentBytes = 1 << 20, size_t maxBytes = 64 << 20, int syncEvery = 32);
+    ~MqttSpool();
+
+    bool open();
+    void close();
+
+    // Store one payload, dropping the oldest segment when the spool is full
+    bool append(const char *data, size_t len);
+
+    // Read the next payload after the ones already peeked, without removing it.
+    // With records peeked, this stops at the end of their segment until they are popped.
+    bool peek(std::string &payload);
+
+    // Acknowledge the oldest peeked record
+    void pop();
+
+    // Forget the peeked records that were not popped; peek() starts over at the oldest
+    void unpeek();
+
+    // Flush written records and the read cursor to disk
+    void sync();
+
+    bool empty() const;
+    bool isOpen() const { return opened; }
+    size_t pendingBytes() const { return totalBytes; }
+    uint64_t droppedBytes() const { return dropped; }
+
+private:
+    std::string segmentPath(uint64_t id) const;
+    bool openWriteSegment(uint64_t id);
+    bool openReadSegment(uint64_t id);
+    void recoverTail(uint64_t id);
+    void dropOldestSegment();
+    void saveCursor();
+    void loadCursor(uint64_t &id, uint64_t &offset);
+
+    std::string dir;
+    size_t segmentBytes;
+    size_t maxBytes;
+    int syncEvery;
+
+    std::deque<uint64_t> segments;
+    uint64_t writeId;
+    uint64_t writeOffset;
+    int writeFd;
+
+    uint64_t readId;
+    uint64_t readOffset;
+    int readFd;
+    std::deque<uint64_t> peeked; // record lengths, oldest first
+    uint64_t peekedBytes;
+
+    size_t totalBytes;
+    int unsynced;
+    int unsavedPops;
+    time_t lastSync;
+    uint64_t dropped;
+    bool opened;
+};
+
+#endif // MQTTSPOOL_H
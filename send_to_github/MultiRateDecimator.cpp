@@ -0,0 +1,154 @@
+#include "MultiRateDecimator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+MultiRateDecimator::MultiRateDecimator()
+    : columns(0), inputRate(1), outputCount(0), historyRows(1), rows(0)
+{
+}
+
+bool MultiRateDecimator::setup(int width, double sampleRate)
+{
+    outputCount = 0;
+    historyRows = 1;
+    history.clear();
+    rows = 0;
+    if (width <= 0 || width > MULTIRATE_MAX_WIDTH || sampleRate <= 0)
+    {
+        cerr << "Invalid decimator setup: " << width << " columns, " << sampleRate << " Hz" << endl;
+        columns = 0;
+        return false;
+    }
+
+    columns = width;
+    inputRate = sampleRate;
+    history.assign(columns, 0.0f);
+    return true;
+}
+
+void MultiRateDecimator::reset()
+{
+    rows = 0;
+    for (int i = 0; i < outputCount; i++)
+    {
+        outputs[i].phase = 0;
+        outputs[i].ready = false;
+    }
+}
+
+int MultiRateDecimator::subscribe(double rateHz, int firstColumn, int count)
+{
+    if (columns == 0 || rateHz <= 0 || firstColumn < 0 || count <= 0 || firstColumn + count > columns)
+    {
+        cerr << "Invalid decimator output: " << rateHz << " Hz, columns " << firstColumn << "+" << count << endl;
+        return -1;
+    }
+
+    int factor = max(1, static_cast<int>(lround(inputRate / rateHz)));
+    for (int i = 0; i < outputCount; i++)
+    {
+        if (outputs[i].factor == factor && outputs[i].first == firstColumn && outputs[i].last == firstColumn + count)
+            return i;
+    }
+    if (outputCount == MULTIRATE_MAX_OUTPUTS)
+    {
+        cerr << "Decimator outputs exhausted" << endl;
+        return -1;
+    }
+
+    Output &out = outputs[outputCount];
+    out.factor = factor;
+    out.first = firstColumn;
+    out.last = firstColumn + count;
+    out.phase = 0;
+    out.ready = false;
+    out.value.assign(columns, 0.0f);
+
+    // Windowed sinc, cut off below the new Nyquist frequency, unit gain at DC
+    int length = factor == 1 ? 1 : MULTIRATE_TAPS_PER_PHASE * factor;
+    out.taps.assign(length, 1.0f);
+    if (length > 1)
+    {
+        double cutoff = MULTIRATE_CUTOFF / factor; // cycles per input sample
+        double middle = (length - 1) / 2.0;
+        double sum = 0;
+        vector<double> h(length);
+        for (int n = 0; n < length; n++)
+        {
+            double t = n - middle;
+            double sinc = t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+            double w = 2 * M_PI * n / (length - 1);
+            h[n] = sinc * (0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w));
+            sum += h[n];
+        }
+        for (int n = 0; n < length; n++)
+            out.taps[n] = static_cast<float>(h[n] / sum);
+    }
+
+    // The history is shared, so it grows to the longest filter and starts over
+    int needed = 1;
+    while (needed < length)
+        needed <<= 1;
+    if (needed > historyRows)
+    {
+        historyRows = needed;
+        history.assign(static_cast<size_t>(historyRows) * columns, 0.0f);
+        reset();
+    }
+
+    return outputCount++;
+}
+
+void MultiRateDecimator::process(const float *frame)
+{
+    if (columns == 0)
+        return;
+
+    // The first frame stands in for the history before it, so the outputs start without a step
+    if (rows == 0)
+    {
+        for (int r = 0; r < historyRows; r++)
+            memcpy(&history[static_cast<size_t>(r) * columns], frame, columns * sizeof(float));
+    }
+    else
+    {
+        memcpy(&history[(rows & (historyRows - 1)) * columns], frame, columns * sizeof(float));
+    }
+    rows++;
+
+    for (int i = 0; i < outputCount; i++)
+    {
+        Output &out = outputs[i];
+        out.ready = ++out.phase == out.factor;
+        if (out.ready)
+        {
+            out.phase = 0;
+            produce(out);
+        }
+    }
+}
+
+// One output row: the filter over the newest frames, a vector multiply-add per tap
+void MultiRateDecimator::produce(Output &out)
+{
+    float *__restrict value = &out.value[out.first];
+    const int width = out.last - out.first;
+    const int length = static_cast<int>(out.taps.size());
+    const float *taps = &out.taps[0];
+    const float *base = &history[out.first];
+    const uint64_t newest = rows - 1;
+    const uint64_t mask = historyRows - 1;
+
+    memset(value, 0, width * sizeof(float));
+    for (int k = 0; k < length; k++)
+    {
+        const float tap = taps[k];
+        const float *__restrict row = base + ((newest - k) & mask) * columns;
+        for (int c = 0; c < width; c++)
+            value[c] += tap * row[c];
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef MULTIRATEDECIMATOR_H
+#define MULTIRATEDECIMATOR_H
+
+#include <stdint.h>
+#include <vector>
+#include "DspCommon.h"
+
+#define MULTIRATE_MAX_WIDTH (4 * DSP_MAX_CHANNELS) // values per input frame
+#define MULTIRATE_MAX_OUTPUTS 4
+#define MULTIRATE_TAPS_PER_PHASE 12 // FIR length is this times the decimation factor
+#define MULTIRATE_CUTOFF 0.4        // of the output rate; alias free up to about 0.37 of it
+
+// One input stream, several lower output rates.
+// A frame is width() floats, e.g. several channels of several signals side by
+// side. Each consumer subscribes to a rate and a run of columns; the rate is
+// rounded to the input rate over a whole factor M, and consumers asking for the
+// same factor share an output. Every output has its own windowed-sinc (Blackman)
+// low-pass of MULTIRATE_TAPS_PER_PHASE * M taps, applied polyphase: only every
+// M-th input produces an output, so the work is MULTIRATE_TAPS_PER_PHASE
+// multiply-adds per column and input frame whatever M is. The input history
+// is shared by all outputs, time-major with columns innermost so each tap is
+// one vector multiply-add over the columns. Outputs lag the input by half the
+// filter, (MULTIRATE_TAPS_PER_PHASE * M - 1) / 2 input frames. A factor of 1
+// passes the frames through unfiltered.
+class MultiRateDecimator
+{
+public:
+    MultiRateDecimator();
+
+    // Drops all subscriptions
+    bool setup(int width, double sampleRate);
+    void reset();
+
+    // Returns the output id, or -1 if the request does not fit
+    int subscribe(double rateHz, int firstColumn, int columns);
+
+    void process(const float *frame);
+
+    // True when the last process() produced a sample on the output
+    bool ready(int id) const { return outputs[id].ready; }
+    const float *output(int id) const { return outputs[id].value.data(); }
+    double rate(int id) const { return inputRate / outputs[id].factor; }
+    int factor(int id) const { return outputs[id].factor; }
+    int width() const { return columns; }
+
+private:
+    struct Output
+    {
+        int factor;
+        int first, last; // columns, half open
+        int phase;
+        bool ready;
+        std::vector<float> taps;
+        std::vector<float> value;
+    };
+
+    void produce(Output &out);
+
+    int columns;
+    double inputRate;
+    int outputCount;
+    Output outputs[MULTIRATE_MAX_OUTPUTS];
+
+    int historyRows; // a power of two, at least the longest filter
+    uint64_t rows;
+    std::vector<float> history;
+};
+
+#endif // MULTIRATEDECIMATOR_H
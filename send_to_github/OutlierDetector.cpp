@@ -0,0 +1,117 @@
+#include "OutlierDetector.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+OutlierDetector::OutlierDetector()
+    : count(0)
+{
+    reset();
+}
+
+bool OutlierDetector::setup(int channels)
+{
+    if (channels <= 0 || channels > DSP_MAX_CHANNELS)
+    {
+        cerr << "Invalid outlier detector setup: " << channels << " channels" << endl;
+        count = 0;
+        return false;
+    }
+
+    count = channels;
+    reset();
+    return true;
+}
+
+void OutlierDetector::reset()
+{
+    filled = 0;
+    next = 0;
+    memset(ring, 0, sizeof(ring));
+    memset(sorted, 0, sizeof(sorted));
+    memset(spikeCount, 0, sizeof(spikeCount));
+    memset(saturatedCount, 0, sizeof(saturatedCount));
+}
+
+// Deviations below the median, m - s[h - j], and above it, s[h + 1 + j] - m,
+// are both ascending; the MAD is the k-th smallest of the two runs merged.
+uint32_t OutlierDetector::medianAbsDeviation(const uint32_t *s, int n) const
+{
+    int h = n / 2;
+    uint32_t m = s[h];
+    int sizeA = h + 1;
+    int sizeB = n - h - 1;
+    int k = n / 2;
+
+    // Take t deviations from below and k + 1 - t from above
+    int lo = max(0, k + 1 - sizeB);
+    int hi = min(k + 1, sizeA);
+    while (lo < hi)
+    {
+        int t = (lo + hi) / 2;
+        uint32_t a = m - s[h - t];
+        uint32_t b = s[h + 1 + k - t] - m;
+        if (a < b)
+            lo = t + 1;
+        else
+            hi = t;
+    }
+
+    uint32_t mad = 0;
+    if (lo > 0)
+        mad = m - s[h - (lo - 1)];
+    if (k + 1 - lo > 0)
+        mad = max(mad, s[h + 1 + k - lo] - m);
+    return mad;
+}
+
+void OutlierDetector::process(const uint32_t *in, uint8_t *flags, uint32_t *median)
+{
+    bool full = filled == OUTLIER_WINDOW;
+    int n = full ? OUTLIER_WINDOW : filled + 1;
+
+    for (int ch = 0; ch < count; ch++)
+    {
+        uint32_t x = in[ch];
+        uint32_t *s = sorted[ch];
+
+        if (full)
+        {
+            // Drop the oldest sample, then open a gap where the new one sorts
+            uint32_t old = ring[ch][next];
+            uint32_t *at = lower_bound(s, s + OUTLIER_WINDOW, old);
+            memmove(at, at + 1, (s + OUTLIER_WINDOW - at - 1) * sizeof(uint32_t));
+        }
+        uint32_t *to = upper_bound(s, s + n - 1, x);
+        memmove(to + 1, to, (s + n - 1 - to) * sizeof(uint32_t));
+        *to = x;
+        ring[ch][next] = x;
+
+        uint32_t m = s[n / 2];
+        uint8_t flag = 0;
+        if (x >= OUTLIER_ADC_MAX)
+        {
+            flag |= OUTLIER_SATURATED;
+            saturatedCount[ch]++;
+        }
+        else if (full)
+        {
+            double limit = OUTLIER_THRESHOLD * 1.4826 * max<uint32_t>(medianAbsDeviation(s, n), OUTLIER_MAD_FLOOR);
+            double deviation = x > m ? x - m : m - x;
+            if (deviation > limit)
+            {
+                flag |= OUTLIER_SPIKE;
+                spikeCount[ch]++;
+            }
+        }
+
+        flags[ch] = flag;
+        median[ch] = m;
+    }
+
+    next = (next + 1) % OUTLIER_WINDOW;
+    if (!full)
+        filled++;
+}
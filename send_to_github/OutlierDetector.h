@@ -0,0 +1,52 @@
+#ifndef OUTLIERDETECTOR_H
+#define OUTLIERDETECTOR_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+
+#define OUTLIER_WINDOW 15      // samples; odd so the median is one of them
+#define OUTLIER_THRESHOLD 6.0  // robust sigmas (1.4826 * MAD) from the median
+#define OUTLIER_MAD_FLOOR 32   // counts; keeps a flat stretch from flagging ADC noise
+#define OUTLIER_ADC_MAX 262143 // 18-bit full scale, the MAX30102 reads this when saturated
+
+// Per-sample flags
+#define OUTLIER_SPIKE 0x01
+#define OUTLIER_SATURATED 0x02
+
+// Hampel-style spike and saturation detector for every channel of a frame.
+// Each channel keeps its last OUTLIER_WINDOW samples twice: in arrival order
+// to know which one leaves, and sorted for the median. The sorted copy is
+// updated with binary searches, so a sample costs O(log w) comparisons plus a
+// shift of at most w words; the MAD is the k-th smallest of the two sorted
+// deviation runs either side of the median, also O(log w).
+// Nothing is rewritten: the caller gets a flag per channel and the window
+// median as a stand-in value, and decides what to do with them.
+class OutlierDetector
+{
+public:
+    OutlierDetector();
+
+    bool setup(int channels);
+    void reset();
+
+    // One frame: channels() raw values in; flags and the median of each window out
+    void process(const uint32_t *in, uint8_t *flags, uint32_t *median);
+
+    int channels() const { return count; }
+    uint64_t spikes(int ch) const { return spikeCount[ch]; }
+    uint64_t saturated(int ch) const { return saturatedCount[ch]; }
+
+private:
+    uint32_t medianAbsDeviation(const uint32_t *sorted, int n) const;
+
+    int count;
+    int filled;
+    int next;
+
+    uint32_t ring[DSP_MAX_CHANNELS][OUTLIER_WINDOW];
+    uint32_t sorted[DSP_MAX_CHANNELS][OUTLIER_WINDOW];
+    uint64_t spikeCount[DSP_MAX_CHANNELS];
+    uint64_t saturatedCount[DSP_MAX_CHANNELS];
+};
+
+#endif // OUTLIERDETECTOR_H
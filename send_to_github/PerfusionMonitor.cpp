@@ -0,0 +1,135 @@
+#include "PerfusionMonitor.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+vector<int> ChannelRoles::referenceChannels() const
+{
+    vector<int> result;
+    for (int i = 0; i < channels(); i++)
+        if (reference[i])
+            result.push_back(i);
+    return result;
+}
+
+vector<int> ChannelRoles::flapChannels() const
+{
+    vector<int> result;
+    for (int i = 0; i < channels(); i++)
+        if (!reference[i])
+            result.push_back(i);
+    return result;
+}
+
+ChannelRoles ChannelRoles::standard(int channels)
+{
+    ChannelRoles roles;
+    for (int i = 0; i < channels; i++)
+        roles.reference.push_back(i % 2 == 0);
+    return roles;
+}
+
+ChannelRoles ChannelRoles::fromEnvironment(int channels)
+{
+    const char *list = getenv(PERFUSION_REFERENCE_ENV);
+    if (!list)
+        return standard(channels);
+
+    ChannelRoles roles;
+    roles.reference.assign(channels, false);
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        int ch = atoi(item.c_str());
+        if (!item.empty() && ch >= 0 && ch < channels)
+            roles.reference[ch] = true;
+    }
+    return roles;
+}
+
+PerfusionMonitor::PerfusionMonitor()
+    : count(0), blockLength(1)
+{
+    configure(0, 1, ChannelRoles());
+}
+
+void PerfusionMonitor::configure(int channels, double sampleRate, const ChannelRoles &roles)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    blockLength = max(1, static_cast<int>(lround(sampleRate * PERFUSION_BLOCK_SECONDS)));
+    blockFill = 0;
+    blockNext = 0;
+    blocksFilled = 0;
+    blocksDone = 0;
+    channelRoles = roles;
+    channelRoles.reference.resize(count, false);
+
+    memset(blocks, 0, sizeof(blocks));
+    memset(index, 0, sizeof(index));
+    referencePi = 0;
+}
+
+void PerfusionMonitor::process(const PipelineFrame &frame)
+{
+    Block &b = blocks[blockNext];
+    for (int ch = 0; ch < count; ch++)
+    {
+        if (frame.quality[ch])
+            continue;
+        double ac = frame.irAc[ch];
+        b.sumSquares[ch] += ac * ac;
+        b.sumDc[ch] += frame.irDc[ch];
+        b.samples[ch]++;
+    }
+
+    if (++blockFill == blockLength)
+        closeBlock();
+}
+
+void PerfusionMonitor::closeBlock()
+{
+    blockFill = 0;
+    blockNext = (blockNext + 1) % PERFUSION_WINDOW_BLOCKS;
+    blocksFilled = min(blocksFilled + 1, PERFUSION_WINDOW_BLOCKS);
+    blocksDone++;
+
+    double referenceSum = 0;
+    int referenceCount = 0;
+    for (int ch = 0; ch < count; ch++)
+    {
+        double squares = 0, dc = 0;
+        uint32_t samples = 0;
+        for (int i = 0; i < blocksFilled; i++)
+        {
+            // Newest first; with a full window the last one is the slot reused next
+            const Block &b = blocks[(blockNext + PERFUSION_WINDOW_BLOCKS - 1 - i) % PERFUSION_WINDOW_BLOCKS];
+            squares += b.sumSquares[ch];
+            dc += b.sumDc[ch];
+            samples += b.samples[ch];
+        }
+
+        // At least one block's worth of clean samples in the window
+        index[ch] = 0;
+        if (samples >= static_cast<uint32_t>(blockLength) && dc > 0)
+        {
+            double rms = sqrt(squares / samples);
+            index[ch] = static_cast<float>(100.0 * 2 * M_SQRT2 * rms / (dc / samples));
+        }
+
+        if (channelRoles.reference[ch] && index[ch] > 0)
+        {
+            referenceSum += index[ch];
+            referenceCount++;
+        }
+    }
+    referencePi = referenceCount ? static_cast<float>(referenceSum / referenceCount) : 0;
+
+    memset(&blocks[blockNext], 0, sizeof(Block));
+}
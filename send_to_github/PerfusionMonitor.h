@@ -0,0 +1,81 @@
+#ifndef PERFUSIONMONITOR_H
+#define PERFUSIONMONITOR_H
+
+#include <stdint.h>
+#include <vector>
+#include "DspCommon.h"
+
+#define PERFUSION_REFERENCE_ENV "COLLECT_REFERENCE_CHANNELS"
+#define PERFUSION_BLOCK_SECONDS 1
+#define PERFUSION_WINDOW_BLOCKS 10
+
+struct PipelineFrame;
+
+// Which channels sit on healthy skin and which on the flap.
+// The reference group is averaged into one baseline; every other channel is a
+// flap site compared against it.
+struct ChannelRoles
+{
+    std::vector<bool> reference;
+
+    int channels() const { return static_cast<int>(reference.size()); }
+    bool isReference(int ch) const { return ch < channels() && reference[ch]; }
+    std::vector<int> referenceChannels() const;
+    std::vector<int> flapChannels() const;
+
+    // Even channels are the reference group, as on the current probe layout
+    static ChannelRoles standard(int channels);
+
+    // PERFUSION_REFERENCE_ENV="0,2,4,6" picks the reference channels
+    static ChannelRoles fromEnvironment(int channels);
+};
+
+// Streaming perfusion index per channel and flap/reference ratios.
+// PI is 100 * AC / DC of the ir signal, with AC the peak-to-peak amplitude of
+// a sine of the same RMS as the pulse band, so it needs no beat detection.
+// Sums are kept per PERFUSION_BLOCK_SECONDS block and the window slides one
+// block at a time over the last PERFUSION_WINDOW_BLOCKS; samples carrying
+// quality flags are left out. O(1) per sample, results change once a block.
+class PerfusionMonitor
+{
+public:
+    PerfusionMonitor();
+
+    void configure(int channels, double sampleRate, const ChannelRoles &roles);
+    void process(const PipelineFrame &frame);
+
+    const ChannelRoles &roles() const { return channelRoles; }
+
+    // Percent; 0 until a window holds enough clean samples
+    float perfusionIndex(int ch) const { return index[ch]; }
+    float referenceIndex() const { return referencePi; }
+    // Flap PI over the reference mean, 0 when either side is missing
+    float ratio(int ch) const { return referencePi > 0 ? index[ch] / referencePi : 0; }
+
+    // Increments each time the window moves on
+    uint32_t updates() const { return blocksDone; }
+
+private:
+    struct Block
+    {
+        double sumSquares[DSP_MAX_CHANNELS];
+        double sumDc[DSP_MAX_CHANNELS];
+        uint32_t samples[DSP_MAX_CHANNELS];
+    };
+
+    void closeBlock();
+
+    int count;
+    int blockLength;
+    int blockFill;
+    int blockNext;
+    int blocksFilled;
+    uint32_t blocksDone;
+    ChannelRoles channelRoles;
+
+    Block blocks[PERFUSION_WINDOW_BLOCKS];
+    float index[DSP_MAX_CHANNELS];
+    float referencePi;
+};
+
+#endif // PERFUSIONMONITOR_H
@@ -0,0 +1,173 @@
+#include "PulseTransit.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static_assert((TRANSIT_HISTORY & (TRANSIT_HISTORY - 1)) == 0, "TRANSIT_HISTORY must be a power of two");
+
+PulseTransit::PulseTransit()
+{
+    configure(0, 1, ChannelRoles());
+}
+
+void PulseTransit::configure(int channels, double sampleRate, const ChannelRoles &roles)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    decimation = max(1, static_cast<int>(lround(sampleRate / TRANSIT_RATE_HZ)));
+    decimationFill = 0;
+    periodNs = static_cast<int64_t>(llround(1e9 * decimation / sampleRate));
+    maxLag = max(1, min(TRANSIT_MAX_LAG, static_cast<int>(lround(TRANSIT_MAX_LAG_SECONDS * sampleRate / decimation))));
+    references = roles.referenceChannels();
+    flaps = roles.flapChannels();
+    references.erase(remove_if(references.begin(), references.end(), [this](int ch) { return ch >= count; }), references.end());
+    flaps.erase(remove_if(flaps.begin(), flaps.end(), [this](int ch) { return ch >= count; }), flaps.end());
+
+    timingChannel = -1;
+    timingBeats = 0;
+    previousBeatNs = 0;
+    pendingStartNs = pendingEndNs = 0;
+    correlated = 0;
+
+    rows = 0;
+    newestNs = 0;
+    referenceSum = 0;
+    memset(decimationSum, 0, sizeof(decimationSum));
+    memset(reference, 0, sizeof(reference));
+    memset(history, 0, sizeof(history));
+    memset(result, 0, sizeof(result));
+}
+
+void PulseTransit::process(const PipelineFrame &frame, const VitalsEstimator &vitals, const SignalQuality &quality)
+{
+    // Reference waveform: mean of the live reference channels
+    float mean = 0;
+    int live = 0;
+    int timing = -1;
+    for (size_t i = 0; i < references.size(); i++)
+    {
+        int ch = references[i];
+        if (quality.level(ch) == SIGNAL_DEAD)
+            continue;
+        mean += frame.irAc[ch];
+        live++;
+        if (timing < 0)
+            timing = ch;
+    }
+    referenceSum += live ? mean / live : 0;
+
+    for (int ch = 0; ch < count; ch++)
+        decimationSum[ch] += frame.irAc[ch];
+
+    if (++decimationFill == decimation)
+    {
+        float scale = 1.0f / decimation;
+        int at = static_cast<int>(rows & (TRANSIT_HISTORY - 1));
+        float *row = history[at];
+        for (int ch = 0; ch < count; ch++)
+        {
+            row[ch] = decimationSum[ch] * scale;
+            decimationSum[ch] = 0;
+        }
+        reference[at] = referenceSum * scale;
+        referenceSum = 0;
+        decimationFill = 0;
+        rows++;
+        newestNs = frame.timestamp_ns;
+    }
+
+    // Beat to beat segments of the reference, timed on one reference channel
+    if (timing != timingChannel)
+    {
+        timingChannel = timing;
+        timingBeats = timing >= 0 ? vitals.channel(timing).beats : 0;
+        previousBeatNs = 0;
+    }
+    else if (timing >= 0 && vitals.channel(timing).beats != timingBeats)
+    {
+        timingBeats = vitals.channel(timing).beats;
+        int64_t beatNs = vitals.channel(timing).lastBeatNs;
+        if (previousBeatNs > 0 && beatNs > previousBeatNs &&
+            beatNs - previousBeatNs <= static_cast<int64_t>(TRANSIT_MAX_BEAT_SECONDS * 1e9))
+        {
+            pendingStartNs = previousBeatNs;
+            pendingEndNs = beatNs;
+        }
+        previousBeatNs = beatNs;
+    }
+
+    // Correlate once the history reaches maxLag past the end of the segment
+    if (pendingEndNs > 0 && rows > 0 && newestNs >= pendingEndNs + maxLag * periodNs)
+    {
+        int64_t back = (newestNs - pendingStartNs + periodNs / 2) / periodNs;
+        int length = static_cast<int>((pendingEndNs - pendingStartNs + periodNs / 2) / periodNs);
+        int64_t available = min<int64_t>(static_cast<int64_t>(rows), TRANSIT_HISTORY);
+        if (length > 0 && back + maxLag < available)
+            correlate(rows - 1 - back, length, quality);
+        pendingEndNs = 0;
+    }
+}
+
+void PulseTransit::correlate(uint64_t start, int length, const SignalQuality &quality)
+{
+    int lags = 2 * maxLag + 1;
+    memset(product, 0, sizeof(product));
+    memset(energy, 0, sizeof(energy));
+
+    float referenceEnergy = 0;
+    for (int n = 0; n < length; n++)
+    {
+        float r = reference[(start + n) & (TRANSIT_HISTORY - 1)];
+        referenceEnergy += r * r;
+        for (int lag = 0; lag < lags; lag++)
+        {
+            const float *row = history[(start + n + lag - maxLag) & (TRANSIT_HISTORY - 1)];
+            float *p = product[lag];
+            float *e = energy[lag];
+            for (int c = 0; c < count; c++)
+            {
+                p[c] += r * row[c];
+                e[c] += row[c] * row[c];
+            }
+        }
+    }
+    if (referenceEnergy <= 0)
+        return;
+
+    for (size_t i = 0; i < flaps.size(); i++)
+    {
+        int ch = flaps[i];
+        if (quality.level(ch) == SIGNAL_DEAD)
+            continue;
+
+        float score[2 * TRANSIT_MAX_LAG + 1] = {0};
+        int best = 0;
+        for (int lag = 0; lag < lags; lag++)
+        {
+            score[lag] = energy[lag][ch] > 0 ? product[lag][ch] / sqrt(referenceEnergy * energy[lag][ch]) : 0;
+            if (score[lag] > score[best])
+                best = lag;
+        }
+
+        // Parabolic interpolation between the neighbouring lags
+        float offset = 0;
+        if (best > 0 && best < lags - 1)
+        {
+            float curve = score[best - 1] - 2 * score[best] + score[best + 1];
+            if (curve < 0)
+                offset = 0.5f * (score[best - 1] - score[best + 1]) / curve;
+        }
+
+        ChannelTransit &t = result[ch];
+        t.delayMs = static_cast<float>((best - maxLag + offset) * periodNs / 1e6);
+        t.similarity = score[best];
+        if (t.similarity >= TRANSIT_MIN_SIMILARITY)
+        {
+            t.averageMs = t.beats ? t.averageMs + 0.2f * (t.delayMs - t.averageMs) : t.delayMs;
+            t.beats++;
+        }
+    }
+    correlated++;
+}
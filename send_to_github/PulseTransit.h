@@ -0,0 +1,81 @@
+#ifndef PULSETRANSIT_H
+#define PULSETRANSIT_H
+
+#include <stdint.h>
+#include <vector>
+#include "DspCommon.h"
+
+#define TRANSIT_RATE_HZ 100          // pulse band is decimated to about this rate first
+#define TRANSIT_HISTORY 512          // decimated samples kept, a power of two
+#define TRANSIT_MAX_LAG_SECONDS 0.25 // flap pulses are searched this far either side
+#define TRANSIT_MAX_LAG 32           // in decimated samples, caps the above at high rates
+#define TRANSIT_MAX_BEAT_SECONDS 2.0 // 30 bpm
+#define TRANSIT_MIN_SIMILARITY 0.6   // beats matching worse than this do not move the average
+
+struct PipelineFrame;
+struct ChannelRoles;
+class VitalsEstimator;
+class SignalQuality;
+
+struct ChannelTransit
+{
+    float delayMs;    // last beat: flap pulse after the reference pulse, negative if before
+    float similarity; // last beat: normalised cross-correlation at that delay, -1..1
+    float averageMs;  // smoothed over the beats that matched well
+    uint32_t beats;   // beats that matched well
+};
+
+// Pulse transit time between the reference group and each flap site, per beat.
+// Beats come from the vitals stage on the first live reference channel; the
+// waveform is the mean ir pulse band of the live reference channels. Each
+// beat-to-beat segment of it is cross-correlated with every channel over
+// +-TRANSIT_MAX_LAG_SECONDS once the history reaches that far past the beat.
+// History and sums are time-major with channels innermost, so each lag is one
+// vector multiply-add across all channels; all storage is fixed in size.
+// Channels should be time aligned (see ChannelAligner) for the delays to be
+// meaningful at the millisecond level.
+class PulseTransit
+{
+public:
+    PulseTransit();
+
+    void configure(int channels, double sampleRate, const ChannelRoles &roles);
+    void process(const PipelineFrame &frame, const VitalsEstimator &vitals, const SignalQuality &quality);
+
+    const std::vector<int> &flapChannels() const { return flaps; }
+    const ChannelTransit &channel(int ch) const { return result[ch]; }
+
+    // Increments with each correlated beat
+    uint32_t updates() const { return correlated; }
+
+private:
+    void correlate(uint64_t start, int length, const SignalQuality &quality);
+
+    int count;
+    int decimation;
+    int decimationFill;
+    int64_t periodNs; // of the decimated history
+    int maxLag;
+    std::vector<int> references;
+    std::vector<int> flaps;
+
+    int timingChannel;
+    uint32_t timingBeats;
+    int64_t previousBeatNs;
+    int64_t pendingStartNs, pendingEndNs;
+    uint32_t correlated;
+
+    uint64_t rows;
+    int64_t newestNs;
+    float referenceSum;
+    int referenceLive;
+    float decimationSum[DSP_MAX_CHANNELS];
+    float reference[TRANSIT_HISTORY];
+    alignas(16) float history[TRANSIT_HISTORY][DSP_MAX_CHANNELS];
+    alignas(16) float product[2 * TRANSIT_MAX_LAG + 1][DSP_MAX_CHANNELS];
+    alignas(16) float energy[2 * TRANSIT_MAX_LAG + 1][DSP_MAX_CHANNELS];
+
+    ChannelTransit result[DSP_MAX_CHANNELS];
+};
+
+#endif // PULSETRANSIT_H
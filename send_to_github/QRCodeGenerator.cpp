@@ -163,14 +163,6 @@ bool QRCodeGenerator::saveQrPng(const char *filename, QRcode *qrcode)
     return true;
 }
 
-size_t QRCodeGenerator::writeCallback(void *contents, size_t size, size_t nmemb, void *userp)
-{
-    size_t totalSize = size * nmemb;
-    std::string *response = static_cast<std::string *>(userp);
-    response->append(static_cast<char *>(contents), totalSize);
-    return totalSize;
-}
-
 void QRCodeGenerator::openQrImage(const std::string &filename)
 {
     std::string command = "feh " + filename;
@@ -189,18 +181,7 @@ std::string QRCodeGenerator::generateAndSendUserMessage()
 
     // Prepare parameters
     std::string param = sample_id;
-    std::string param_encoded;
-    CURL *curl = curl_easy_init();
-    if (curl)
-    {
-        char *encoded_sample_id = curl_easy_escape(curl, sample_id.c_str(), sample_id.length());
-        if (encoded_sample_id)
-        {
-            param_encoded = encoded_sample_id;
-            curl_free(encoded_sample_id);
-        }
-        curl_easy_cleanup(curl);
-    }
+    std::string param_encoded = HttpClient::escape(sample_id);
 
     // Generate QR code
     QRcode *qrcode = QRcode_encodeString(param.c_str(), 1, QR_ECLEVEL_L, QR_MODE_8, 1);
@@ -223,70 +204,58 @@ std::string QRCodeGenerator::generateAndSendUserMessage()
     openQrImage("QRcode.png");
 
     // Send HTTP GET request
-    std::string response_data;
-    curl = curl_easy_init();
-    if (curl)
+    std::string server_url = "http://sp.grifcc.top:8080/collect/get_user";
+    HttpClient::Request request;
+    request.url = server_url + "?sample_id=" + param_encoded;
+    request.timeoutSec = 5;
+
+    HttpClient::Response response;
+    HttpClient::instance().perform(request, response);
+    CURLcode res = response.result;
+    if (res != CURLE_OK)
     {
-        std::string server_url = "http://sp.grifcc.top:8080/collect/get_user";
-        std::string full_url = server_url + "?sample_id=" + param_encoded;
-
-        curl_easy_setopt(curl, CURLOPT_URL, full_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK)
+        if (res == CURLE_OPERATION_TIMEDOUT)
         {
-            if (res == CURLE_OPERATION_TIMEDOUT)
-            {
-                std::cout << "Connection timeout!" << std::endl;
-            }
-            else if (res == CURLE_COULDNT_CONNECT)
-            {
-                std::cout << "Failed to connect to the server. Please check your network or server status." << std::endl;
-            }
-            else
-            {
-                std::cout << "Request failed: " << curl_easy_strerror(res) << std::endl;
-            }
+            std::cout << "Connection timeout!" << std::endl;
+        }
+        else if (res == CURLE_COULDNT_CONNECT)
+        {
+            std::cout << "Failed to connect to the server. Please check your network or server status." << std::endl;
         }
         else
         {
-            long response_code;
-            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-            if (response_code == 200)
+            std::cout << "Request failed: " << curl_easy_strerror(res) << std::endl;
+        }
+    }
+    else
+    {
+        long response_code = response.status;
+        const std::string &response_data = response.body;
+        if (response_code == 200)
+        {
+            // Parse JSON response
+            try
             {
-                // Parse JSON response
-                try
+                auto json_response = nlohmann::json::parse(response_data);
+                if (json_response.contains("user_uuid"))
                 {
-                    auto json_response = nlohmann::json::parse(response_data);
-                    if (json_response.contains("user_uuid"))
-                    {
-                        user_uuid = json_response["user_uuid"].get<std::string>();
-                        std::cout << "Success! Retrieved user_uuid: " << user_uuid << std::endl;
-                    }
-                    else
-                    {
-                        std::cout << "Failed to retrieve user_uuid from response." << std::endl;
-                    }
+                    user_uuid = json_response["user_uuid"].get<std::string>();
+                    std::cout << "Success! Retrieved user_uuid: " << user_uuid << std::endl;
                 }
-                catch (nlohmann::json::parse_error &e)
+                else
                 {
-                    std::cout << "Failed to parse JSON response: " << e.what() << std::endl;
+                    std::cout << "Failed to retrieve user_uuid from response." << std::endl;
                 }
             }
-            else
+            catch (nlohmann::json::parse_error &e)
             {
-                std::cout << "Request failed with status code " << response_code << ", Response: " << response_data << std::endl;
+                std::cout << "Failed to parse JSON response: " << e.what() << std::endl;
             }
         }
-
-        curl_easy_cleanup(curl);
-    }
-    else
-    {
-        std::cerr << "Failed to initialize CURL." << std::endl;
+        else
+        {
+            std::cout << "Request failed with status code " << response_code << ", Response: " << response_data << std::endl;
+        }
     }
 
     // Print sample_id and user_uuid (if any)
@@ -13,7 +13,7 @@
 #include <cstring>
 #include <qrencode.h>
 #include <png.h>
-#include <curl/curl.h>
+#include "HttpClient.h"
 #include <nlohmann/json.hpp>
 using namespace std;
 
@@ -46,9 +46,6 @@ private:
     // Saves QR code as PNG
     bool saveQrPng(const char *filename, QRcode *qrcode);
 
-    // Callback function for handling CURL data
-    static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp);
-
     // Opens the QR code image using a system command
     void openQrImage(const std::string &filename);
 };
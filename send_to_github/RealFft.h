@@ -0,0 +1,144 @@
+#ifndef REALFFT_H
+#define REALFFT_H
+
+#include <cmath>
+#include "DspCommon.h"
+
+// Real FFT of N samples (N a power of two) for a batch of channels.
+// Samples are time-major, x[n * DSP_MAX_CHANNELS + ch], the same one-array-
+// per-quantity layout the other stages use, so every butterfly is a plain loop
+// over channels that the compiler turns into DSP_LANES-wide vector code.
+// The N real samples are packed as N/2 complex ones, transformed by an
+// iterative radix-2 FFT and split into the N/2 + 1 bins of the real spectrum.
+// Tables and work space are members: no allocation after construction.
+// The object is large for big N (two N/2 x DSP_MAX_CHANNELS float arrays);
+// keep it inside a heap-allocated owner rather than on the stack.
+template <int N>
+class RealFft
+{
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "RealFft needs a power of two of at least 4");
+
+public:
+    enum { Size = N, Bins = N / 2 + 1 };
+
+    RealFft()
+    {
+        for (int i = 0; i < M; i++)
+        {
+            int r = 0;
+            for (int bit = 1, v = i; bit < M; bit <<= 1, v >>= 1)
+                r = (r << 1) | (v & 1);
+            reversed[i] = r;
+
+            splitCos[i] = static_cast<float>(cos(2 * M_PI * i / N));
+            splitSin[i] = static_cast<float>(sin(2 * M_PI * i / N));
+        }
+        for (int i = 0; i < M / 2; i++)
+        {
+            twiddleCos[i] = static_cast<float>(cos(2 * M_PI * i / M));
+            twiddleSin[i] = static_cast<float>(sin(2 * M_PI * i / M));
+        }
+    }
+
+    // x: N rows, re/im: Bins rows, all with a row stride of DSP_MAX_CHANNELS
+    void transform(const float *x, int channels, float *re, float *im)
+    {
+        complexTransform(x, channels);
+        split(channels, re, im, nullptr);
+    }
+
+    // |X[k]|^2 per bin and channel, Bins rows
+    void power(const float *x, int channels, float *out)
+    {
+        complexTransform(x, channels);
+        split(channels, nullptr, nullptr, out);
+    }
+
+private:
+    enum { M = N / 2 };
+
+    void complexTransform(const float *x, int channels)
+    {
+        // Even samples are the real part, odd ones the imaginary part
+        for (int i = 0; i < M; i++)
+        {
+            const float *even = x + (2 * reversed[i]) * DSP_MAX_CHANNELS;
+            const float *odd = even + DSP_MAX_CHANNELS;
+            float *wr = workRe[i];
+            float *wi = workIm[i];
+            for (int c = 0; c < channels; c++)
+            {
+                wr[c] = even[c];
+                wi[c] = odd[c];
+            }
+        }
+
+        for (int size = 2; size <= M; size <<= 1)
+        {
+            int half = size >> 1;
+            int step = M / size;
+            for (int start = 0; start < M; start += size)
+            {
+                for (int j = 0; j < half; j++)
+                {
+                    float wc = twiddleCos[j * step];
+                    float ws = -twiddleSin[j * step];
+                    float *ar = workRe[start + j], *ai = workIm[start + j];
+                    float *br = workRe[start + j + half], *bi = workIm[start + j + half];
+                    for (int c = 0; c < channels; c++)
+                    {
+                        float tr = wc * br[c] - ws * bi[c];
+                        float ti = wc * bi[c] + ws * br[c];
+                        br[c] = ar[c] - tr;
+                        bi[c] = ai[c] - ti;
+                        ar[c] += tr;
+                        ai[c] += ti;
+                    }
+                }
+            }
+        }
+    }
+
+    // X[k] = E[k] + W^k O[k] with E, O the spectra of the even and odd samples,
+    // recovered from Z[k] and conj(Z[M - k])
+    void split(int channels, float *re, float *im, float *out)
+    {
+        for (int k = 0; k <= M; k++)
+        {
+            const float *zr = workRe[k % M], *zi = workIm[k % M];
+            const float *yr = workRe[(M - k) % M], *yi = workIm[(M - k) % M];
+            float wc = k < M ? splitCos[k] : -1.0f;
+            float ws = k < M ? splitSin[k] : 0.0f;
+            float *rowRe = re ? re + k * DSP_MAX_CHANNELS : nullptr;
+            float *rowIm = im ? im + k * DSP_MAX_CHANNELS : nullptr;
+            float *rowOut = out ? out + k * DSP_MAX_CHANNELS : nullptr;
+            for (int c = 0; c < channels; c++)
+            {
+                float er = 0.5f * (zr[c] + yr[c]);
+                float ei = 0.5f * (zi[c] - yi[c]);
+                float orr = 0.5f * (zi[c] + yi[c]);
+                float oi = -0.5f * (zr[c] - yr[c]);
+                // e^{-i 2 pi k / N} * O
+                float xr = er + wc * orr + ws * oi;
+                float xi = ei + wc * oi - ws * orr;
+                if (rowOut)
+                {
+                    rowOut[c] = xr * xr + xi * xi;
+                }
+                else
+                {
+                    rowRe[c] = xr;
+                    rowIm[c] = xi;
+                }
+            }
+        }
+    }
+
+    int reversed[M];
+    float twiddleCos[M / 2], twiddleSin[M / 2];
+    float splitCos[M], splitSin[M];
+    alignas(16) float workRe[M][DSP_MAX_CHANNELS];
+    alignas(16) float workIm[M][DSP_MAX_CHANNELS];
+};
+
+#endif // REALFFT_H
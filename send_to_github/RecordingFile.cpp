@@ -0,0 +1,533 @@
+#include "RecordingFile.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+using namespace std;
+
+static_assert(sizeof(RecordingHeader) == 256, "recording header layout changed");
+static_assert(sizeof(RecordingBlockHeader) == 32, "recording block layout changed");
+static_assert(sizeof(RecordingIndexEntry) == 24, "recording index layout changed");
+static_assert(sizeof(RecordingTrailer) == 32, "recording trailer layout changed");
+
+static uint32_t crc(const void *data, size_t len)
+{
+    return static_cast<uint32_t>(crc32(0L, static_cast<const Bytef *>(data), static_cast<uInt>(len)));
+}
+
+static void copy_field(char *dst, size_t size, const string &value)
+{
+    memset(dst, 0, size);
+    memcpy(dst, value.data(), min(value.size(), size - 1));
+}
+
+static inline void put_varint(vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static inline bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static inline uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void encode_column(vector<uint8_t> &out, const uint32_t *values, size_t count)
+{
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        put_varint(out, zigzag(static_cast<int64_t>(values[i]) - previous));
+        previous = values[i];
+    }
+}
+
+static bool decode_column(const uint8_t *&p, const uint8_t *end, uint32_t *values, size_t count)
+{
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t raw;
+        if (!get_varint(p, end, raw))
+            return false;
+        previous += unzigzag(raw);
+        values[i] = static_cast<uint32_t>(previous);
+    }
+    return true;
+}
+
+RecordingWriter::RecordingWriter()
+    : channelCount(0), blockFrames(RECORDING_BLOCK_FRAMES), offset(0), totalFrames(0), frames(0)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+}
+
+string RecordingWriter::pathFor(const string &sample_id, const string &start_unix)
+{
+    // sample_id comes from the QR code, keep it to one path component
+    string name = sample_id;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        if (name[i] == '/' || name[i] == '\\')
+            name[i] = '_';
+    }
+    if (name.empty() || name == "." || name == "..")
+        name = "_";
+    return string(RECORDING_DIR) + "/" + name + "_" + start_unix + ".ppgr";
+}
+
+bool RecordingWriter::open(const string &path, const RecordingProfile &profile,
+                           const string &sample_id, const string &user_uuid, int64_t start_unix)
+{
+    close();
+
+    if (profile.channels <= 0 || profile.channels > RECORDING_MAX_CHANNELS)
+    {
+        cerr << "Invalid recording channel count: " << profile.channels << endl;
+        return false;
+    }
+
+    size_t slash = path.rfind('/');
+    if (slash != string::npos && mkdir(path.substr(0, slash).c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        perror("Failed to create recording directory");
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        perror("Failed to create recording");
+        return false;
+    }
+
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RECORDING_MAGIC;
+    header.version = RECORDING_VERSION;
+    header.header_size = sizeof(RecordingHeader);
+    header.channels = static_cast<uint16_t>(profile.channels);
+    header.block_frames = static_cast<uint16_t>(blockFrames);
+    header.sample_rate = profile.sample_rate;
+    header.start_unix = start_unix;
+    copy_field(header.sensor, sizeof(header.sensor), profile.sensor);
+    header.mode_config = profile.mode_config;
+    header.spo2_config = profile.spo2_config;
+    header.fifo_config = profile.fifo_config;
+    header.red_led = profile.red_led;
+    header.ir_led = profile.ir_led;
+    header.pilot_pa = profile.pilot_pa;
+    copy_field(header.sample_id, sizeof(header.sample_id), sample_id);
+    copy_field(header.user_uuid, sizeof(header.user_uuid), user_uuid);
+    header.crc = crc(&header, offsetof(RecordingHeader, crc));
+
+    // Synced along with the first block
+    if (!write_all(fd, &header, sizeof(header)))
+    {
+        perror("Failed to write recording header");
+        ::close(fd);
+        return false;
+    }
+    writer.start(fd, "recording");
+
+    channelCount = profile.channels;
+    offset = sizeof(header);
+    totalFrames = 0;
+    frames = 0;
+    timestamps.assign(blockFrames, 0);
+    red.assign(blockFrames * channelCount, 0);
+    ir.assign(blockFrames * channelCount, 0);
+    index.clear();
+    return true;
+}
+
+bool RecordingWriter::append(int64_t timestamp_ns, const uint32_t *redFrame, const uint32_t *irFrame)
+{
+    if (!writer.isOpen())
+        return false;
+    if (writer.failed())
+    {
+        abandon();
+        return false;
+    }
+
+    timestamps[frames] = timestamp_ns;
+    for (int ch = 0; ch < channelCount; ch++)
+    {
+        red[ch * blockFrames + frames] = redFrame[ch];
+        ir[ch * blockFrames + frames] = irFrame[ch];
+    }
+    frames++;
+
+    if (frames == blockFrames)
+        return flushBlock();
+    return true;
+}
+
+bool RecordingWriter::flushBlock()
+{
+    if (frames == 0)
+        return true;
+
+    encoded.resize(sizeof(RecordingBlockHeader));
+
+    int64_t previous = 0;
+    for (size_t i = 0; i < frames; i++)
+    {
+        put_varint(encoded, zigzag(timestamps[i] - previous));
+        previous = timestamps[i];
+    }
+    for (int ch = 0; ch < channelCount; ch++)
+        encode_column(encoded, &red[ch * blockFrames], frames);
+    for (int ch = 0; ch < channelCount; ch++)
+        encode_column(encoded, &ir[ch * blockFrames], frames);
+
+    RecordingBlockHeader block;
+    block.magic = RECORDING_BLOCK_MAGIC;
+    block.frames = static_cast<uint32_t>(frames);
+    block.first_ts = timestamps[0];
+    block.last_ts = timestamps[frames - 1];
+    block.payload = static_cast<uint32_t>(encoded.size() - sizeof(block));
+    block.crc = crc(encoded.data() + sizeof(block), block.payload);
+    memcpy(encoded.data(), &block, sizeof(block));
+
+    // Blocks start 8-byte aligned so the reader can use their headers in place
+    encoded.resize((encoded.size() + 7) & ~static_cast<size_t>(7), 0);
+
+    RecordingIndexEntry entry;
+    entry.first_ts = block.first_ts;
+    entry.offset = offset;
+    entry.frames = block.frames;
+    entry.reserved = 0;
+    index.push_back(entry);
+
+    offset += encoded.size();
+    totalFrames += frames;
+    frames = 0;
+
+    // Written and synced on the writer thread; a crash costs the blocks still queued
+    if (!writer.write(encoded))
+    {
+        abandon();
+        return false;
+    }
+    return true;
+}
+
+bool RecordingWriter::close()
+{
+    if (!writer.isOpen())
+        return true;
+
+    if (!flushBlock())
+        return false;
+
+    RecordingTrailer trailer;
+    trailer.magic = RECORDING_INDEX_MAGIC;
+    trailer.blocks = static_cast<uint32_t>(index.size());
+    trailer.index_offset = offset;
+    trailer.frames = totalFrames;
+    trailer.crc = crc(index.data(), index.size() * sizeof(RecordingIndexEntry));
+    trailer.reserved = 0;
+
+    const uint8_t *entries = reinterpret_cast<const uint8_t *>(index.data());
+    encoded.assign(entries, entries + index.size() * sizeof(RecordingIndexEntry));
+    encoded.insert(encoded.end(), reinterpret_cast<const uint8_t *>(&trailer),
+                   reinterpret_cast<const uint8_t *>(&trailer) + sizeof(trailer));
+
+    bool ok = writer.write(encoded);
+    ok = writer.finish() && ok;
+    index.clear();
+    return ok;
+}
+
+void RecordingWriter::abandon()
+{
+    // Whatever reached the disk stays readable through the block scan
+    writer.finish();
+    index.clear();
+}
+
+RecordingReader::RecordingReader()
+    : base(nullptr), mappedBytes(0), head(nullptr), entries(nullptr), blocks(0), indexed(false),
+      totalFrames(0), lastTs(0), currentBlock(0), currentFrames(0), position(0)
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+    close();
+}
+
+bool RecordingReader::open(const string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Failed to open recording");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RecordingHeader))
+    {
+        cerr << "Recording " << path << " is too short" << endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    base = static_cast<const uint8_t *>(addr);
+    mappedBytes = st.st_size;
+    head = reinterpret_cast<const RecordingHeader *>(base);
+
+    if (head->magic != RECORDING_MAGIC || head->version != RECORDING_VERSION ||
+        head->header_size != sizeof(RecordingHeader) ||
+        head->crc != crc(head, offsetof(RecordingHeader, crc)) ||
+        head->channels == 0 || head->channels > RECORDING_MAX_CHANNELS)
+    {
+        cerr << "Recording " << path << " has no valid header" << endl;
+        close();
+        return false;
+    }
+
+    if (!loadIndex())
+    {
+        cerr << "Recording " << path << " was not closed, rebuilding its index" << endl;
+        scanBlocks();
+    }
+
+    if (blocks > 0)
+    {
+        const RecordingBlockHeader *last = reinterpret_cast<const RecordingBlockHeader *>(base + entries[blocks - 1].offset);
+        lastTs = last->last_ts;
+    }
+
+    rewind();
+    return true;
+}
+
+void RecordingReader::close()
+{
+    if (base)
+        munmap(const_cast<uint8_t *>(base), mappedBytes);
+    base = nullptr;
+    mappedBytes = 0;
+    head = nullptr;
+    entries = nullptr;
+    blocks = 0;
+    indexed = false;
+    scanned.clear();
+    totalFrames = 0;
+    lastTs = 0;
+    currentFrames = 0;
+    position = 0;
+}
+
+bool RecordingReader::loadIndex()
+{
+    if (mappedBytes < sizeof(RecordingHeader) + sizeof(RecordingTrailer))
+        return false;
+
+    const RecordingTrailer *trailer = reinterpret_cast<const RecordingTrailer *>(base + mappedBytes - sizeof(RecordingTrailer));
+    if (trailer->magic != RECORDING_INDEX_MAGIC)
+        return false;
+
+    uint64_t indexBytes = static_cast<uint64_t>(trailer->blocks) * sizeof(RecordingIndexEntry);
+    if (trailer->index_offset % 8 != 0 || trailer->index_offset < sizeof(RecordingHeader) ||
+        trailer->index_offset + indexBytes + sizeof(RecordingTrailer) != mappedBytes)
+        return false;
+
+    const RecordingIndexEntry *table = reinterpret_cast<const RecordingIndexEntry *>(base + trailer->index_offset);
+    if (crc(table, indexBytes) != trailer->crc)
+        return false;
+
+    for (size_t i = 0; i < trailer->blocks; i++)
+    {
+        if (table[i].offset + sizeof(RecordingBlockHeader) > trailer->index_offset)
+            return false;
+    }
+
+    entries = table;
+    blocks = trailer->blocks;
+    totalFrames = trailer->frames;
+    indexed = true;
+    return true;
+}
+
+void RecordingReader::scanBlocks()
+{
+    // Only the block headers are read; the payload crc is checked when a block is decoded
+    uint64_t offset = sizeof(RecordingHeader);
+    totalFrames = 0;
+    while (offset + sizeof(RecordingBlockHeader) <= mappedBytes)
+    {
+        const RecordingBlockHeader *block = reinterpret_cast<const RecordingBlockHeader *>(base + offset);
+        if (block->magic != RECORDING_BLOCK_MAGIC || block->frames == 0 ||
+            offset + sizeof(RecordingBlockHeader) + block->payload > mappedBytes)
+            break;
+
+        RecordingIndexEntry entry;
+        entry.first_ts = block->first_ts;
+        entry.offset = offset;
+        entry.frames = block->frames;
+        entry.reserved = 0;
+        scanned.push_back(entry);
+
+        totalFrames += block->frames;
+        offset += (sizeof(RecordingBlockHeader) + block->payload + 7) & ~static_cast<uint64_t>(7);
+    }
+    entries = scanned.data();
+    blocks = scanned.size();
+}
+
+int64_t RecordingReader::firstTimestamp() const
+{
+    return blocks > 0 ? entries[0].first_ts : 0;
+}
+
+size_t RecordingReader::findBlock(int64_t timestamp_ns) const
+{
+    size_t lo = 0, hi = blocks;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].first_ts <= timestamp_ns)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+bool RecordingReader::decodeBlock(size_t index)
+{
+    currentBlock = index;
+    currentFrames = 0;
+    position = 0;
+
+    const RecordingBlockHeader *block = reinterpret_cast<const RecordingBlockHeader *>(base + entries[index].offset);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(block + 1);
+    const uint8_t *end = p + block->payload;
+    if (block->magic != RECORDING_BLOCK_MAGIC || end > base + mappedBytes || crc(p, block->payload) != block->crc)
+    {
+        cerr << "Recording block " << index << " is damaged" << endl;
+        return false;
+    }
+
+    size_t count = block->frames;
+    size_t channels = head->channels;
+    timestamps.resize(count);
+    red.resize(count * channels);
+    ir.resize(count * channels);
+
+    int64_t previous = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t raw;
+        if (!get_varint(p, end, raw))
+            return false;
+        previous += unzigzag(raw);
+        timestamps[i] = previous;
+    }
+    for (size_t ch = 0; ch < channels; ch++)
+    {
+        if (!decode_column(p, end, &red[ch * count], count))
+            return false;
+    }
+    for (size_t ch = 0; ch < channels; ch++)
+    {
+        if (!decode_column(p, end, &ir[ch * count], count))
+            return false;
+    }
+
+    currentFrames = count;
+    return true;
+}
+
+bool RecordingReader::seek(int64_t timestamp_ns)
+{
+    if (blocks == 0)
+        return false;
+
+    size_t index = findBlock(timestamp_ns);
+    if (!decodeBlock(index))
+        return false;
+
+    position = lower_bound(timestamps.begin(), timestamps.begin() + currentFrames, timestamp_ns) - timestamps.begin();
+    return true;
+}
+
+void RecordingReader::rewind()
+{
+    currentBlock = 0;
+    currentFrames = 0;
+    position = 0;
+    if (blocks > 0)
+        decodeBlock(0);
+}
+
+bool RecordingReader::next(RecordingFrame &frame)
+{
+    while (position >= currentFrames)
+    {
+        // A damaged block is skipped, the following ones are still usable
+        if (currentBlock + 1 >= blocks)
+            return false;
+        decodeBlock(currentBlock + 1);
+    }
+
+    size_t channels = head->channels;
+    frame.timestamp_ns = timestamps[position];
+    frame.red.resize(channels);
+    frame.ir.resize(channels);
+    for (size_t ch = 0; ch < channels; ch++)
+    {
+        frame.red[ch] = red[ch * currentFrames + position];
+        frame.ir[ch] = ir[ch * currentFrames + position];
+    }
+    position++;
+    return true;
+}
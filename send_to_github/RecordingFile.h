@@ -0,0 +1,237 @@
+#ifndef RECORDINGFILE_H
+#define RECORDINGFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "SyncWriter.h"
+
+// On-device copy of every session (recordings/<sample_id>_<start_unix>.ppgr).
+//
+// Layout, version 1 (all fields little endian, offsets in bytes):
+//
+//   0    RecordingHeader (256 bytes)
+//          magic         uint32  'PPGR' (0x52475050)
+//          version       uint16  RECORDING_VERSION
+//          header_size   uint16  sizeof(RecordingHeader)
+//          channels      uint16  channels per frame
+//          block_frames  uint16  frames per block (the last block may hold fewer)
+//          sample_rate   uint32  nominal frames per second
+//          start_unix    int64
+//          sensor        char[16], NUL padded
+//          mode_config .. pilot_pa   uint8 sensor register values for the session
+//          sample_id     char[64], NUL padded
+//          user_uuid     char[64], NUL padded
+//          crc           uint32  crc32 of the 252 bytes before it
+//   256  blocks, back to back:
+//          RecordingBlockHeader (32 bytes)
+//            magic       uint32  'RBLK' (0x4B4C4252)
+//            frames      uint32
+//            first_ts    int64   timestamp_ns of the first frame
+//            last_ts     int64   timestamp_ns of the last frame
+//            payload     uint32  bytes of payload that follow
+//            crc         uint32  crc32 of the payload
+//          payload: the timestamp column, then red of channel 0..n-1, then ir of
+//          channel 0..n-1. Each column is delta coded against the previous
+//          value (0 for the first), zigzag mapped and written as LEB128 varints.
+//          Zero padding follows so the next block starts 8-byte aligned.
+//   footer, written when the recording is closed:
+//          RecordingIndexEntry[blocks] (24 bytes each): first_ts, offset, frames
+//          RecordingTrailer (32 bytes), always the last bytes of the file
+//            magic       uint32  'RIDX' (0x58444952)
+//            blocks      uint32
+//            index_offset uint64
+//            frames      uint64  total frames in the recording
+//            crc         uint32  crc32 of the index entries
+//
+// The file is append only. Blocks are written and synced in order by a
+// background thread, so after a crash everything up to the last synced block
+// is readable; a recording without a valid trailer is indexed by walking the
+// block headers instead.
+
+#define RECORDING_DIR "recordings"
+#define RECORDING_MAGIC 0x52475050u
+#define RECORDING_BLOCK_MAGIC 0x4B4C4252u
+#define RECORDING_INDEX_MAGIC 0x58444952u
+#define RECORDING_VERSION 1
+#define RECORDING_BLOCK_FRAMES 512
+#define RECORDING_MAX_CHANNELS 256
+
+struct RecordingHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t channels;
+    uint16_t block_frames;
+    uint32_t sample_rate;
+    int64_t start_unix;
+    char sensor[16];
+    uint8_t mode_config;
+    uint8_t spo2_config;
+    uint8_t fifo_config;
+    uint8_t red_led;
+    uint8_t ir_led;
+    uint8_t pilot_pa;
+    uint8_t reserved0[2];
+    char sample_id[64];
+    char user_uuid[64];
+    uint8_t reserved1[76];
+    uint32_t crc;
+};
+
+struct RecordingBlockHeader
+{
+    uint32_t magic;
+    uint32_t frames;
+    int64_t first_ts;
+    int64_t last_ts;
+    uint32_t payload;
+    uint32_t crc;
+};
+
+struct RecordingIndexEntry
+{
+    int64_t first_ts;
+    uint64_t offset;
+    uint32_t frames;
+    uint32_t reserved;
+};
+
+struct RecordingTrailer
+{
+    uint32_t magic;
+    uint32_t blocks;
+    uint64_t index_offset;
+    uint64_t frames;
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// Sensor setup stored in the header so a recording can be interpreted later
+struct RecordingProfile
+{
+    std::string sensor;
+    uint32_t sample_rate;
+    int channels;
+    uint8_t mode_config;
+    uint8_t spo2_config;
+    uint8_t fifo_config;
+    uint8_t red_led;
+    uint8_t ir_led;
+    uint8_t pilot_pa;
+};
+
+struct RecordingFrame
+{
+    int64_t timestamp_ns;
+    std::vector<uint32_t> red;
+    std::vector<uint32_t> ir;
+};
+
+class RecordingWriter
+{
+public:
+    RecordingWriter();
+    ~RecordingWriter();
+
+    static std::string pathFor(const std::string &sample_id, const std::string &start_unix);
+
+    bool open(const std::string &path, const RecordingProfile &profile,
+              const std::string &sample_id, const std::string &user_uuid, int64_t start_unix);
+
+    // One frame, channels() values each; a full block is compressed here and
+    // handed to the writer thread. False once a write has failed.
+    bool append(int64_t timestamp_ns, const uint32_t *red, const uint32_t *ir);
+
+    // Writes the last partial block and the index, and waits for them to be synced
+    bool close();
+
+    bool isOpen() const { return writer.isOpen(); }
+    int channels() const { return channelCount; }
+
+private:
+    RecordingWriter(const RecordingWriter &) = delete;
+    RecordingWriter &operator=(const RecordingWriter &) = delete;
+
+    bool flushBlock();
+    void abandon();
+
+    SyncWriter writer;
+    int channelCount;
+    size_t blockFrames;
+    uint64_t offset;
+    uint64_t totalFrames;
+
+    // Current block, column per channel: red[channel * blockFrames + frame]
+    size_t frames;
+    std::vector<int64_t> timestamps;
+    std::vector<uint32_t> red;
+    std::vector<uint32_t> ir;
+
+    std::vector<uint8_t> encoded;
+    std::vector<RecordingIndexEntry> index;
+};
+
+// Read side; the file is memory mapped and only the pages that are used get
+// touched. seek() is a binary search over the index followed by one decoded block.
+class RecordingReader
+{
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    const RecordingHeader &header() const { return *head; }
+    int channels() const { return head ? head->channels : 0; }
+
+    size_t blockCount() const { return blocks; }
+    uint64_t frameCount() const { return totalFrames; }
+    int64_t firstTimestamp() const;
+    int64_t lastTimestamp() const { return lastTs; }
+
+    // True when the trailer was missing or damaged and the index was rebuilt by scanning
+    bool recovered() const { return !indexed; }
+
+    // Last block starting at or before timestamp_ns (block 0 for earlier timestamps)
+    size_t findBlock(int64_t timestamp_ns) const;
+
+    // Positions next() on the first frame at or after timestamp_ns
+    bool seek(int64_t timestamp_ns);
+    void rewind();
+    bool next(RecordingFrame &frame);
+
+private:
+    RecordingReader(const RecordingReader &) = delete;
+    RecordingReader &operator=(const RecordingReader &) = delete;
+
+    bool loadIndex();
+    void scanBlocks();
+    bool decodeBlock(size_t block);
+
+    const uint8_t *base;
+    size_t mappedBytes;
+    const RecordingHeader *head;
+
+    // Points into the mapping, or into scanned for a recovered file
+    const RecordingIndexEntry *entries;
+    size_t blocks;
+    bool indexed;
+    std::vector<RecordingIndexEntry> scanned;
+    uint64_t totalFrames;
+    int64_t lastTs;
+
+    // Decoded block the cursor is in, same column layout as the writer
+    size_t currentBlock;
+    size_t currentFrames;
+    size_t position;
+    std::vector<int64_t> timestamps;
+    std::vector<uint32_t> red;
+    std::vector<uint32_t> ir;
+};
+
+#endif // RECORDINGFILE_H
@@ -0,0 +1,85 @@
+#include "ReplaySource.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+ReplaySource::ReplaySource(const string &path, double speed, QObject *parent)
+    : FrameSource(parent), pacer(speed)
+{
+    if (!reader.open(path))
+        qDebug() << "Replay file" << QString::fromStdString(path) << "could not be opened";
+}
+
+RecordingProfile ReplaySource::profile() const
+{
+    RecordingProfile profile;
+    profile.sample_rate = 0;
+    profile.channels = 0;
+    profile.mode_config = profile.spo2_config = profile.fifo_config = 0;
+    profile.red_led = profile.ir_led = profile.pilot_pa = 0;
+    if (!reader.isOpen())
+        return profile;
+
+    const RecordingHeader &header = reader.header();
+    profile.sensor.assign(header.sensor, strnlen(header.sensor, sizeof(header.sensor)));
+    profile.sample_rate = header.sample_rate;
+    profile.channels = min<int>(header.channels, FRAME_MAX_CHANNELS);
+    profile.mode_config = header.mode_config;
+    profile.spo2_config = header.spo2_config;
+    profile.fifo_config = header.fifo_config;
+    profile.red_led = header.red_led;
+    profile.ir_led = header.ir_led;
+    profile.pilot_pa = header.pilot_pa;
+    return profile;
+}
+
+void ReplaySource::run()
+{
+    if (!reader.isOpen())
+        return;
+
+    reader.rewind();
+    pacer.start();
+
+    MaxData data;
+    memset(&data, 0, sizeof(data));
+    data.channels = min(reader.channels(), FRAME_MAX_CHANNELS);
+    for (int i = 0; i < data.channels; i++)
+        data.channel_id[i] = i;
+
+    RecordingFrame frame;
+    int64_t firstTs = 0;
+    bool first = true;
+
+    while (reader.next(frame))
+    {
+        if (first)
+            firstTs = frame.timestamp_ns;
+        first = false;
+
+        if (!pacer.wait(frame.timestamp_ns - firstTs))
+            break;
+
+        data.timestamp_ns = frame.timestamp_ns;
+        for (int i = 0; i < data.channels; i++)
+        {
+            data.redData[i] = frame.red[i];
+            data.irData[i] = frame.ir[i];
+        }
+        emitFrame(data);
+    }
+
+    pacer.report("Replayed");
+}
+
+void ReplaySource::Quit()
+{
+    pacer.quit();
+}
+
+void ReplaySource::frameHandled()
+{
+    pacer.handled();
+}
@@ -0,0 +1,35 @@
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <string>
+#include "FrameSource.h"
+#include "RecordingFile.h"
+
+// Selects replay instead of the sensor chain: COLLECT_REPLAY=<file.ppgr>,
+// optionally COLLECT_REPLAY_SPEED=<factor> (1 real time, 0 as fast as possible)
+#define REPLAY_FILE_ENV "COLLECT_REPLAY"
+#define REPLAY_SPEED_ENV "COLLECT_REPLAY_SPEED"
+
+// Feeds a recorded session through the live pipeline.
+// Frames carry the timestamps they were recorded with, so every run of the same
+// file produces the same data downstream; only the wall clock pacing changes.
+class ReplaySource : public FrameSource
+{
+    Q_OBJECT
+public:
+    ReplaySource(const std::string &path, double speed = 1.0, QObject *parent = nullptr);
+
+    bool isValid() const { return reader.isOpen(); }
+    const RecordingReader &recording() const { return reader; }
+
+    RecordingProfile profile() const override;
+    void run() override;
+    void Quit() override;
+    void frameHandled() override;
+
+private:
+    RecordingReader reader;
+    FramePacer pacer;
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,106 @@
+#include "SessionBuffer.h"
+#include <cstring>
+
+using namespace std;
+
+SampleBlockPool::FreeList::~FreeList()
+{
+    for (size_t i = 0; i < blocks.size(); i++)
+        delete blocks[i];
+}
+
+SampleBlockPool::SampleBlockPool(size_t maxFree)
+    : freeList(make_shared<FreeList>())
+{
+    freeList->maxFree = maxFree;
+}
+
+shared_ptr<SampleBlock> SampleBlockPool::acquire()
+{
+    SampleBlock *block = nullptr;
+    {
+        lock_guard<mutex> lock(freeList->mutex);
+        if (!freeList->blocks.empty())
+        {
+            block = freeList->blocks.back();
+            freeList->blocks.pop_back();
+        }
+    }
+    if (!block)
+        block = new SampleBlock;
+    block->count = 0;
+    block->channels = 0;
+    memset(block->quality, SESSION_UNRATED, sizeof(block->quality));
+
+    shared_ptr<FreeList> owner = freeList;
+    return shared_ptr<SampleBlock>(block, [owner](SampleBlock *released)
+                                   {
+                                       lock_guard<mutex> lock(owner->mutex);
+                                       if (owner->blocks.size() < owner->maxFree)
+                                           owner->blocks.push_back(released);
+                                       else
+                                           delete released;
+                                   });
+}
+
+size_t SampleBlockPool::freeBlocks() const
+{
+    lock_guard<mutex> lock(freeList->mutex);
+    return freeList->blocks.size();
+}
+
+SessionBuffer::SessionBuffer()
+    : samples(0)
+{
+}
+
+void SessionBuffer::clear()
+{
+    blocks.clear();
+    samples = 0;
+}
+
+void SessionBuffer::append(int64_t timestamp_ns, int channel, int red, int ir)
+{
+    if (blocks.empty() || blocks.back()->full())
+        blocks.push_back(pool.acquire());
+
+    SampleBlock &block = *blocks.back();
+    size_t i = block.count;
+    block.timestamp_ns[i] = timestamp_ns;
+    block.channel[i] = channel;
+    block.red[i] = red;
+    block.ir[i] = ir;
+    block.count = i + 1;
+    samples++;
+}
+
+void SessionBuffer::rate(int channel, int level)
+{
+    // Nothing open, the last block was handed out
+    if (blocks.empty() || channel < 0 || channel >= SESSION_MAX_CHANNELS)
+        return;
+
+    SampleBlock &block = *blocks.back();
+    if (level < block.quality[channel])
+        block.quality[channel] = static_cast<uint8_t>(level);
+    if (channel >= block.channels)
+        block.channels = channel + 1;
+}
+
+vector<SampleBlockRef> SessionBuffer::take(bool includePartial)
+{
+    // The receiver holds the only reference from here on
+    size_t done = 0;
+    while (done < blocks.size() && (blocks[done]->full() || includePartial))
+        done++;
+
+    vector<SampleBlockRef> ready;
+    for (size_t i = 0; i < done; i++)
+    {
+        if (blocks[i]->count > 0)
+            ready.push_back(std::move(blocks[i]));
+    }
+    blocks.erase(blocks.begin(), blocks.begin() + done);
+    return ready;
+}
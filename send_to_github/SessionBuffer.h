@@ -0,0 +1,95 @@
+#ifndef SESSIONBUFFER_H
+#define SESSIONBUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define SESSION_BLOCK_SAMPLES 4000
+#define SESSION_POOL_BLOCKS 32
+#define SESSION_MAX_CHANNELS 128
+#define SESSION_UNRATED 0xFF // quality of a channel nothing was rated for
+
+// Fixed-size block of samples in columnar layout.
+// One block is also one upload chunk, so the uploader can point straight at
+// the columns instead of copying them.
+struct SampleBlock
+{
+    size_t count;
+    int64_t timestamp_ns[SESSION_BLOCK_SAMPLES];
+    int32_t channel[SESSION_BLOCK_SAMPLES];
+    int32_t red[SESSION_BLOCK_SAMPLES];
+    int32_t ir[SESSION_BLOCK_SAMPLES];
+
+    // Worst signal level rated per channel while the block was open; uploaded
+    // as a tag next to the samples, which are always all sent
+    int channels; // 1 + highest channel rated
+    uint8_t quality[SESSION_MAX_CHANNELS];
+
+    bool full() const { return count == SESSION_BLOCK_SAMPLES; }
+};
+
+// Read-only handle; the block goes back to its pool when the last one is dropped
+typedef std::shared_ptr<const SampleBlock> SampleBlockRef;
+
+// Free list of blocks shared by all sessions.
+// Blocks may be released from any thread (the uploader drops them once they
+// are on disk); up to maxFree are kept for reuse, the rest are freed.
+class SampleBlockPool
+{
+public:
+    explicit SampleBlockPool(size_t maxFree = SESSION_POOL_BLOCKS);
+
+    std::shared_ptr<SampleBlock> acquire();
+    size_t freeBlocks() const;
+
+private:
+    struct FreeList
+    {
+        ~FreeList();
+
+        std::mutex mutex;
+        std::vector<SampleBlock *> blocks;
+        size_t maxFree;
+    };
+
+    // Outlives the pool if blocks are still out when it is destroyed
+    std::shared_ptr<FreeList> freeList;
+};
+
+// Samples of the current session as a chain of pooled blocks.
+// There is no length limit; the buffer only holds the blocks not handed out
+// yet, so its memory stays flat over a session and a block goes back to the
+// pool as soon as its new owner drops it. Written from the GUI thread only;
+// blocks handed out by take() are never written again, so other threads may
+// read them without locking.
+class SessionBuffer
+{
+public:
+    SessionBuffer();
+
+    // Drops the blocks not handed out; they return to the pool
+    void clear();
+
+    void append(int64_t timestamp_ns, int channel, int red, int ir);
+
+    // Rates a channel for the block being filled; the block keeps the lowest level
+    void rate(int channel, int level);
+
+    size_t size() const { return samples; } // appended this session, handed out or not
+    size_t blockCount() const { return blocks.size(); }
+    const SampleBlock &block(size_t index) const { return *blocks[index]; }
+
+    // Hands the full blocks over and forgets them, plus the partial last one
+    // when includePartial is set (end of session; later samples start a new block)
+    std::vector<SampleBlockRef> take(bool includePartial);
+
+private:
+    SampleBlockPool pool;
+    std::vector<std::shared_ptr<SampleBlock>> blocks;
+    size_t samples;
+};
+
+#endif // SESSIONBUFFER_H
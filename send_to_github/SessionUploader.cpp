@@ -0,0 +1,629 @@
+#include "SessionUploader.h"
+#include <iostream>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+
+SessionUploader::SessionUploader(const string &baseUrl, const string &spoolDir, int workers)
+    : baseUrl(baseUrl), codec(UPLOAD_CODEC), level(UPLOAD_COMPRESS_LEVEL), spool(spoolDir),
+      nextSeq(0), storing(false), stopping(false), halted(false), jitter(std::random_device()())
+{
+    resume();
+    for (int i = 0; i < max(workers, 1); i++)
+        this->workers.push_back(thread(&SessionUploader::work, this));
+}
+
+SessionUploader::~SessionUploader()
+{
+    shutdown();
+}
+
+SessionUploader &SessionUploader::instance()
+{
+    static SessionUploader uploader;
+    return uploader;
+}
+
+void SessionUploader::shutdown()
+{
+    {
+        lock_guard<mutex> lock(jobMutex);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    jobCond.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+
+    if (!jobs.empty())
+        cout << "Upload stopped with " << jobs.size() << " requests left in the upload spool" << endl;
+}
+
+void SessionUploader::begin(const string &sample_id, const string &user_uuid, const string &start_unix, int frequency)
+{
+    if (current)
+        finish();
+
+    current = make_shared<Session>();
+    current->sample_id = sample_id;
+    current->user_uuid = user_uuid;
+    current->start_unix = start_unix;
+    current->frequency = frequency;
+    current->chunks = 0;
+    current->committed = false;
+    current->dir = spool.sessionDir(sample_id, start_unix);
+    current->legacy = false;
+    current->commits = 0;
+    current->inflight = 0;
+    current->rawBytes = 0;
+    current->sentBytes = 0;
+    current->encodeMs = 0;
+
+    nextSeq = 0;
+}
+
+void SessionUploader::append(const SampleBlockRef &block)
+{
+    if (!current || !block || block->count == 0)
+        return;
+
+    // The block is shared, not copied; the acquisition side never writes to it again
+    Job job;
+    job.session = current;
+    job.commit = false;
+    job.seq = nextSeq++;
+    job.chunks = 0;
+    job.stored = false;
+    job.priority = HTTP_PRIORITY_HIGH;
+    job.block = block;
+    enqueue(std::move(job));
+}
+
+void SessionUploader::finish()
+{
+    if (!current)
+        return;
+
+    Job job;
+    job.session = current;
+    job.commit = true;
+    job.seq = 0;
+    job.chunks = nextSeq;
+    job.stored = false;
+    job.priority = HTTP_PRIORITY_HIGH;
+    enqueue(std::move(job));
+
+    current.reset();
+}
+
+void SessionUploader::setCompression(UploadCodec codec, int level)
+{
+    this->codec = codec;
+    this->level = level;
+}
+
+void SessionUploader::enqueue(Job &&job)
+{
+    job.retryAt = chrono::steady_clock::now();
+    job.backoffMs = UPLOAD_RETRY_MIN_MS;
+    {
+        lock_guard<mutex> lock(jobMutex);
+        incoming.push_back(std::move(job));
+    }
+    jobCond.notify_one();
+}
+
+deque<SessionUploader::Job>::iterator SessionUploader::nextJob(chrono::steady_clock::time_point &wake)
+{
+    // After stop() every job gets one more try, without waiting out its backoff
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    wake = chrono::steady_clock::time_point::max();
+
+    deque<Job>::iterator low = jobs.end();
+    vector<const Session *> chunksAhead;
+    for (deque<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it)
+    {
+        const Session *session = it->session.get();
+        bool blocked = it->commit && (session->inflight > 0 ||
+                                      find(chunksAhead.begin(), chunksAhead.end(), session) != chunksAhead.end());
+        if (!it->commit)
+            chunksAhead.push_back(session);
+        if (blocked)
+            continue;
+
+        if (!stopping && it->retryAt > now)
+        {
+            wake = min(wake, it->retryAt);
+            continue;
+        }
+        if (it->priority == HTTP_PRIORITY_HIGH)
+            return it;
+        if (low == jobs.end())
+            low = it;
+    }
+    return low;
+}
+
+void SessionUploader::work()
+{
+    unique_lock<mutex> lock(jobMutex);
+    while (true)
+    {
+        // New chunks go to disk right away, even while the network is backing off.
+        // One worker at a time so they reach the queue in the order they were captured.
+        if (!incoming.empty() && !storing)
+        {
+            deque<Job> arrived;
+            arrived.swap(incoming);
+            storing = true;
+            lock.unlock();
+            for (size_t i = 0; i < arrived.size(); i++)
+                store(arrived[i]);
+            lock.lock();
+            for (size_t i = 0; i < arrived.size(); i++)
+                jobs.push_back(std::move(arrived[i]));
+            storing = false;
+            jobCond.notify_all();
+            continue;
+        }
+
+        if (halted)
+            break;
+
+        chrono::steady_clock::time_point wake;
+        deque<Job>::iterator next = nextJob(wake);
+        if (next == jobs.end())
+        {
+            if (stopping && incoming.empty() && !storing && jobs.empty())
+                break;
+            if (wake == chrono::steady_clock::time_point::max())
+                jobCond.wait(lock);
+            else
+                jobCond.wait_until(lock, wake);
+            continue;
+        }
+
+        Job job = std::move(*next);
+        jobs.erase(next);
+        Session &session = *job.session;
+        if (!job.commit)
+            session.inflight++;
+        lock.unlock();
+
+        vector<int> missing;
+        Result result = job.commit ? commitSession(job, missing) : uploadChunk(job);
+
+        lock.lock();
+        if (!job.commit)
+            session.inflight--;
+
+        if (result == JOB_RESEND)
+        {
+            // Resend just those chunks, then commit again
+            jobs.push_front(job);
+            for (size_t i = missing.size(); i-- > 0;)
+            {
+                Job resend;
+                resend.session = job.session;
+                resend.commit = false;
+                resend.seq = missing[i];
+                resend.chunks = 0;
+                resend.stored = true;
+                resend.priority = job.priority;
+                resend.retryAt = chrono::steady_clock::now();
+                resend.backoffMs = UPLOAD_RETRY_MIN_MS;
+                jobs.push_front(std::move(resend));
+            }
+        }
+        else if (result == JOB_RETRY)
+        {
+            if (stopping)
+            {
+                // Nothing is lost: everything still queued is in the spool and resumes on the next start
+                halted = true;
+                jobs.push_front(std::move(job));
+                jobCond.notify_all();
+                break;
+            }
+
+            // Equal jitter, like the MQTT reconnect
+            uniform_int_distribution<int> dis(job.backoffMs / 2, job.backoffMs);
+            int delay = dis(jitter);
+            job.retryAt = chrono::steady_clock::now() + chrono::milliseconds(delay);
+            job.backoffMs = min(job.backoffMs * 2, UPLOAD_RETRY_MAX_MS);
+            cout << "Upload failed, retrying in " << delay << " ms" << endl;
+            jobs.push_front(std::move(job));
+        }
+        jobCond.notify_all();
+    }
+}
+
+void SessionUploader::resume()
+{
+    vector<string> dirs = spool.listSessions();
+    for (size_t i = 0; i < dirs.size(); i++)
+    {
+        shared_ptr<Session> session = make_shared<Session>();
+        if (!spool.loadMeta(dirs[i], *session))
+            continue;
+
+        session->dir = dirs[i];
+        session->legacy = false;
+        session->commits = 0;
+        session->inflight = 0;
+        session->rawBytes = 0;
+        session->sentBytes = 0;
+        session->encodeMs = 0;
+
+        vector<int> seqs = spool.listChunks(session->dir, false);
+        cout << "Resuming upload of " << session->sample_id << ", " << seqs.size() << " of " << session->chunks
+             << " chunks pending" << (session->committed ? "" : " (capture was interrupted)") << endl;
+
+        for (size_t k = 0; k < seqs.size(); k++)
+        {
+            Job job;
+            job.session = session;
+            job.commit = false;
+            job.seq = seqs[k];
+            job.chunks = 0;
+            job.stored = true;
+            job.priority = HTTP_PRIORITY_LOW;
+            job.retryAt = chrono::steady_clock::now();
+            job.backoffMs = UPLOAD_RETRY_MIN_MS;
+            jobs.push_back(std::move(job));
+        }
+
+        // An interrupted capture is committed with whatever reached the disk
+        if (!session->committed)
+        {
+            session->committed = true;
+            spool.saveMeta(session->dir, *session);
+        }
+
+        Job commit;
+        commit.session = session;
+        commit.commit = true;
+        commit.seq = 0;
+        commit.chunks = session->chunks;
+        commit.stored = true;
+        commit.priority = HTTP_PRIORITY_LOW;
+        commit.retryAt = chrono::steady_clock::now();
+        commit.backoffMs = UPLOAD_RETRY_MIN_MS;
+        jobs.push_back(std::move(commit));
+    }
+}
+
+void SessionUploader::store(Job &job)
+{
+    Session &session = *job.session;
+    if (job.commit)
+    {
+        session.committed = true;
+        session.chunks = job.chunks;
+        spool.saveMeta(session.dir, session);
+        job.stored = true;
+        return;
+    }
+
+    session.chunks = max(session.chunks, job.seq + 1);
+    const SampleBlock &block = *job.block;
+    if (spool.writeChunk(session.dir, job.seq, block.channel, block.red, block.ir, block.count, block.quality, block.channels) &&
+        spool.saveMeta(session.dir, session))
+    {
+        // Read back when it is sent, so a long outage does not hold pool blocks
+        job.stored = true;
+        job.block.reset();
+    }
+    else
+    {
+        cerr << "Chunk " << job.seq << " of " << session.sample_id << " could not be saved, keeping it in memory" << endl;
+    }
+}
+
+bool SessionUploader::transient(const HttpClient::Response &response)
+{
+    // No answer, server trouble or throttling; anything else will not get better by resending
+    return response.result != CURLE_OK || response.status >= 500 || response.status == 408 || response.status == 429;
+}
+
+bool SessionUploader::routeMissing(const HttpClient::Response &response)
+{
+    // gin answers an unknown route with a plain-text 404. The chunk handlers answer a
+    // sample they do not know with a JSON error, which is not a reason to give up on chunks
+    if (response.status != 404)
+        return false;
+    nlohmann::json reply = nlohmann::json::parse(response.body, nullptr, false);
+    return !reply.is_object() || !reply.contains("error");
+}
+
+bool SessionUploader::post(const string &url, JsonStreamWriter &body, Session &session, HttpPriority priority,
+                           HttpClient::Response &response, bool compress)
+{
+    while (true)
+    {
+        // The body is encoded and compressed straight into curl's send buffer
+        CompressedBody encoded(body, compress ? static_cast<UploadCodec>(codec.load()) : CODEC_IDENTITY, level);
+
+        HttpClient::Request request;
+        request.url = url;
+        request.post = true;
+        request.timeoutSec = 30;
+        request.priority = priority;
+        request.throttled = true;
+        request.headers.push_back("Content-Type: application/json");
+        if (encoded.contentEncoding())
+        {
+            request.headers.push_back(string("Content-Encoding: ") + encoded.contentEncoding());
+            request.headers.push_back("Transfer-Encoding: chunked");
+        }
+        request.readFn = CompressedBody::curlRead;
+        request.seekFn = CompressedBody::curlSeek;
+        request.readData = &encoded;
+        request.bodySize = static_cast<curl_off_t>(encoded.size());
+
+        response = HttpClient::Response();
+        bool ok = HttpClient::instance().perform(request, response);
+
+        if (response.status == 415 && encoded.codec() != CODEC_IDENTITY)
+        {
+            UploadCodec next = encoded.codec() == CODEC_ZSTD ? CODEC_GZIP : CODEC_IDENTITY;
+            cout << "Server rejected " << encoded.contentEncoding() << ", retrying with " << CompressedBody::codecName(next) << endl;
+            codec = next;
+            continue;
+        }
+
+        lock_guard<mutex> lock(jobMutex);
+        session.rawBytes += encoded.bytesIn();
+        session.sentBytes += encoded.bytesOut();
+        session.encodeMs += encoded.encodeMs();
+        return ok;
+    }
+}
+
+void SessionUploader::report(const Session &session, const char *what)
+{
+    double ratio = session.rawBytes ? 100.0 * session.sentBytes / session.rawBytes : 100.0;
+    cout << "Session " << session.sample_id << " " << what << ", " << session.rawBytes << " -> " << session.sentBytes
+         << " bytes (" << ratio << "%), encode " << session.encodeMs << " ms" << endl;
+}
+
+SessionUploader::Result SessionUploader::uploadChunk(Job &job)
+{
+    Session &session = *job.session;
+    if (session.legacy)
+        return JOB_DONE; // stays in the spool and goes out with the commit
+
+    // Straight from the block columns, or from the spool copy
+    IntSpan channel, red, ir, quality;
+    UploadChunk loaded;
+    if (job.stored)
+    {
+        if (!spool.readChunk(session.dir, job.seq, loaded))
+            return JOB_FAILED;
+        channel = {loaded.channel.data(), loaded.channel.size()};
+        red = {loaded.red.data(), loaded.red.size()};
+        ir = {loaded.ir.data(), loaded.ir.size()};
+    }
+    else
+    {
+        const SampleBlock &block = *job.block;
+        loaded.quality.assign(block.quality, block.quality + block.channels);
+        channel = {block.channel, block.count};
+        red = {block.red, block.count};
+        ir = {block.ir, block.count};
+    }
+    quality = {loaded.quality.data(), loaded.quality.size()};
+
+    // Keys in sorted order, matching what nlohmann::json::dump() produced before
+    JsonStreamWriter body;
+    body.openObject();
+    body.key("channel_id");
+    body.intArray(&channel, 1);
+    body.key("data");
+    body.openObject();
+    body.key("ir");
+    body.intArray(&ir, 1);
+    body.key("reds");
+    body.intArray(&red, 1);
+    body.closeObject();
+    // Worst signal level per channel over the chunk (SignalLevel, 255 unrated); the samples are all there regardless
+    if (quality.count > 0)
+    {
+        body.key("quality");
+        body.intArray(&quality, 1);
+    }
+    body.key("sample_id");
+    body.string(&session.sample_id);
+    body.key("seq");
+    body.integer(job.seq);
+    body.key("session");
+    body.string(&session.start_unix);
+    body.key("user_uuid");
+    body.string(&session.user_uuid);
+    body.closeObject();
+
+    HttpClient::Response response;
+    if (post(baseUrl + "/data/chunk", body, session, job.priority, response))
+    {
+        if (job.stored)
+            spool.markAcked(session.dir, job.seq);
+        return JOB_DONE;
+    }
+
+    if (routeMissing(response))
+    {
+        // Old backend: the session is sent in one piece from the spool at commit time
+        if (!session.legacy.exchange(true))
+            cout << "Chunk upload not supported by server, falling back to single POST" << endl;
+        return JOB_DONE;
+    }
+
+    if (transient(response))
+        return JOB_RETRY;
+
+    // The commit will list it as missing and it gets another try from there
+    cerr << "Chunk " << job.seq << " of " << session.sample_id << " failed, status " << response.status << endl;
+    return JOB_FAILED;
+}
+
+SessionUploader::Result SessionUploader::commitSession(Job &job, vector<int> &missing)
+{
+    Session &session = *job.session;
+    if (session.legacy)
+        return sendLegacy(session);
+
+    JsonStreamWriter body;
+    body.openObject();
+    body.key("Start_Unix");
+    body.string(&session.start_unix);
+    body.key("chunks");
+    body.integer(job.chunks);
+    body.key("frequency");
+    body.integer(session.frequency);
+    body.key("sample_id");
+    body.string(&session.sample_id);
+    body.key("session");
+    body.string(&session.start_unix);
+    body.key("user_uuid");
+    body.string(&session.user_uuid);
+    body.closeObject();
+
+    HttpClient::Response response;
+    if (post(baseUrl + "/data/commit", body, session, HTTP_PRIORITY_HIGH, response))
+    {
+        cout << "Session " << session.sample_id << " committed, " << job.chunks << " chunks" << endl;
+        report(session, "sent");
+        spool.removeSession(session.dir);
+        return JOB_DONE;
+    }
+
+    if (response.status == 409 && ++session.commits < UPLOAD_MAX_COMMITS)
+    {
+        try
+        {
+            nlohmann::json reply = nlohmann::json::parse(response.body);
+            if (reply.contains("missing"))
+                missing = reply["missing"].get<vector<int>>();
+        }
+        catch (nlohmann::json::exception &e)
+        {
+            cerr << "Failed to parse commit response: " << e.what() << endl;
+        }
+
+        if (!missing.empty())
+        {
+            cout << "Server is missing " << missing.size() << " chunks of " << session.sample_id << ", resending" << endl;
+            return JOB_RESEND;
+        }
+    }
+
+    if (transient(response))
+        return JOB_RETRY;
+
+    cerr << "Commit of " << session.sample_id << " failed, status " << response.status << ", kept in " << session.dir << endl;
+    return JOB_FAILED;
+}
+
+// The spooled chunks of a session, read back one at a time; shared by the columns
+struct SpoolCursor
+{
+    const UploadStore *store;
+    const string *dir;
+    vector<int> seqs;
+    size_t loaded;
+    UploadChunk chunk;
+
+    bool load(size_t index)
+    {
+        if (index == loaded)
+            return true;
+        loaded = seqs.size();
+        if (!store->readChunk(*dir, seqs[index], chunk))
+            return false;
+        loaded = index;
+        return true;
+    }
+};
+
+// One column of every chunk, as the spans of one JSON array
+class SpoolColumn : public IntSpanSource
+{
+public:
+    SpoolColumn(SpoolCursor &cursor, vector<int> UploadChunk::*column) : cursor(cursor), column(column) {}
+
+    size_t spanCount() const override { return cursor.seqs.size(); }
+
+    bool span(size_t index, IntSpan &out) override
+    {
+        if (!cursor.load(index))
+            return false;
+        const vector<int> &values = cursor.chunk.*column;
+        out.data = values.data();
+        out.count = values.size();
+        return true;
+    }
+
+private:
+    SpoolCursor &cursor;
+    vector<int> UploadChunk::*column;
+};
+
+SessionUploader::Result SessionUploader::sendLegacy(Session &session)
+{
+    // The arrays are streamed chunk by chunk from the spool, so only one chunk
+    // is in memory however long the session was
+    SpoolCursor cursor;
+    cursor.store = &spool;
+    cursor.dir = &session.dir;
+    cursor.seqs = spool.listChunks(session.dir, true);
+    cursor.loaded = cursor.seqs.size();
+    SpoolColumn channel(cursor, &UploadChunk::channel);
+    SpoolColumn red(cursor, &UploadChunk::red);
+    SpoolColumn ir(cursor, &UploadChunk::ir);
+
+    JsonStreamWriter body;
+    body.openObject();
+    body.key("Start_Unix");
+    body.string(&session.start_unix);
+    body.key("channel_id");
+    body.intArray(&channel);
+    body.key("data");
+    body.openObject();
+    body.key("ir");
+    body.intArray(&ir);
+    body.key("reds");
+    body.intArray(&red);
+    body.closeObject();
+    body.key("frequency");
+    body.integer(session.frequency);
+    body.key("sample_id");
+    body.string(&session.sample_id);
+    body.key("user_uuid");
+    body.string(&session.user_uuid);
+    body.closeObject();
+
+    HttpClient::Response response;
+    // The old backend has no Content-Encoding support and would answer 400, not 415
+    if (post(baseUrl + "/data", body, session, HTTP_PRIORITY_LOW, response, false))
+    {
+        report(session, "sent");
+        spool.removeSession(session.dir);
+        return JOB_DONE;
+    }
+
+    // A chunk that could not be read back aborts the body; resending will not help
+    if (body.failed())
+    {
+        cerr << "Spool of " << session.sample_id << " is damaged, kept in " << session.dir << endl;
+        return JOB_FAILED;
+    }
+
+    if (transient(response))
+        return JOB_RETRY;
+
+    cerr << "Upload of " << session.sample_id << " failed, status " << response.status << ", kept in " << session.dir << endl;
+    return JOB_FAILED;
+}
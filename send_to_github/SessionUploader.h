@@ -0,0 +1,147 @@
+#ifndef SESSIONUPLOADER_H
+#define SESSIONUPLOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include "JsonStreamWriter.h"
+#include "CompressedBody.h"
+#include "UploadStore.h"
+#include "HttpClient.h"
+#include "SessionBuffer.h"
+
+#define UPLOAD_BASE_URL "http://sp.grifcc.top:8080/collect"
+#define UPLOAD_CODEC CODEC_GZIP
+#define UPLOAD_COMPRESS_LEVEL 6
+#define UPLOAD_RETRY_MIN_MS 1000
+#define UPLOAD_RETRY_MAX_MS 60000
+#define UPLOAD_MAX_COMMITS 3
+#define UPLOAD_WORKERS 2
+
+// Uploads a session while it is being captured.
+// Each SessionBuffer block becomes one numbered chunk that is POSTed to
+// /collect/data/chunk as soon as it is handed over; finish() only sends a
+// small /collect/data/commit. Chunks and commit carry the session start time
+// next to the sample_id, so a sample measured twice keeps its sessions apart.
+// Servers without the chunk endpoint get the whole session in one
+// /collect/data POST at the end instead.
+// Requests go through the shared HttpClient; the uploader thread only keeps
+// them in order. Bodies are compressed while they are sent; a server that
+// answers 415 gets the next simpler encoding from then on. The single POST
+// is always sent uncompressed: the backends without the chunk endpoint
+// predate Content-Encoding and reject a compressed body with a plain 400.
+//
+// Every chunk is written to the UploadStore before it is sent and stays
+// there until the commit succeeds. Network and 5xx failures are retried
+// with backoff, a commit that reports missing chunks resends just those,
+// and sessions left over from a crash or power cut are resumed on start.
+//
+// The process has one uploader (instance()), so the spool is resumed once and
+// no two uploaders ever work on the same session; main() creates it at start
+// and calls shutdown() before the HttpClient goes away.
+//
+// UPLOAD_WORKERS threads take jobs from one queue. Chunks of a session may go
+// out in parallel; its commit waits until none of them is queued or in
+// flight. Live chunks and commits go first, resumed backlog and whole-session
+// bodies run at low priority, and all bodies count against the HttpClient
+// bandwidth limit.
+class SessionUploader
+{
+public:
+    explicit SessionUploader(const std::string &baseUrl = UPLOAD_BASE_URL, const std::string &spoolDir = UPLOAD_SPOOL_DIR,
+                             int workers = UPLOAD_WORKERS);
+    ~SessionUploader();
+
+    static SessionUploader &instance();
+
+    // Sends what is queued, stops the workers; anything left resumes on the next start
+    void shutdown();
+
+    // Called from the acquisition side; never block on the network or the disk
+    void begin(const std::string &sample_id, const std::string &user_uuid, const std::string &start_unix, int frequency);
+    void append(const SampleBlockRef &block);
+    void finish();
+
+    // Takes effect from the next request
+    void setCompression(UploadCodec codec, int level);
+
+private:
+    struct Session : public UploadMeta
+    {
+        std::string dir;
+        std::atomic<bool> legacy;
+        int commits;
+        int inflight; // chunks being sent right now
+
+        // Guarded by jobMutex
+        size_t rawBytes;
+        size_t sentBytes;
+        double encodeMs;
+    };
+
+    struct Job
+    {
+        std::shared_ptr<Session> session;
+        bool commit;
+        int seq;
+        int chunks;
+        bool stored;       // chunk data lives in the spool, not in chunk
+        SampleBlockRef block; // columns to send until stored
+        HttpPriority priority;
+
+        // Per job backoff
+        std::chrono::steady_clock::time_point retryAt;
+        int backoffMs;
+    };
+
+    enum Result
+    {
+        JOB_DONE,
+        JOB_RETRY,  // transient, try the same job again after a backoff
+        JOB_RESEND, // commit came back with missing chunks
+        JOB_FAILED  // permanent for now, left in the spool for the next start
+    };
+
+    void enqueue(Job &&job);
+    void work();
+    std::deque<Job>::iterator nextJob(std::chrono::steady_clock::time_point &wake);
+
+    void resume();
+    void store(Job &job);
+    Result uploadChunk(Job &job);
+    Result commitSession(Job &job, std::vector<int> &missing);
+    Result sendLegacy(Session &session);
+    bool post(const std::string &url, JsonStreamWriter &body, Session &session, HttpPriority priority,
+              HttpClient::Response &response, bool compress = true);
+    void report(const Session &session, const char *what);
+    static bool transient(const HttpClient::Response &response);
+    static bool routeMissing(const HttpClient::Response &response);
+
+    std::string baseUrl;
+    std::atomic<int> codec;
+    std::atomic<int> level;
+    UploadStore spool;
+
+    // Acquisition side
+    std::shared_ptr<Session> current;
+    int nextSeq;
+
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobCond;
+    std::deque<Job> incoming; // handed over, not stored yet
+    std::deque<Job> jobs;     // stored, waiting to be sent
+    bool storing;
+    bool stopping;
+    bool halted; // a job failed after stop(), leave the rest for the next start
+    std::mt19937 jitter;
+};
+
+#endif // SESSIONUPLOADER_H
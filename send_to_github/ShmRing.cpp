@@ -0,0 +1,242 @@
+#include "ShmRing.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static_assert(sizeof(ShmRingHeader) == 64, "shared memory header layout changed");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory ring needs lock-free 64-bit atomics");
+
+static size_t slot_bytes(int channels)
+{
+    size_t raw = sizeof(ShmSlotHeader) + 2 * sizeof(uint32_t) * channels;
+    return (raw + 63) & ~static_cast<size_t>(63);
+}
+
+// Clears the magic of a ring left behind by an earlier writer, so its readers
+// reopen instead of waiting on a mapping nobody publishes into any more
+static void retire_ring(const char *shmName)
+{
+    int fd = shm_open(shmName, O_RDWR, 0);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmRingHeader))
+    {
+        void *addr = mmap(nullptr, sizeof(ShmRingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            static_cast<ShmRingHeader *>(addr)->magic.store(0, memory_order_release);
+            munmap(addr, sizeof(ShmRingHeader));
+        }
+    }
+    ::close(fd);
+}
+
+ShmRingWriter::ShmRingWriter()
+    : header(nullptr), slots(nullptr), mappedBytes(0), next(0)
+{
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    destroy();
+}
+
+bool ShmRingWriter::create(const char *shmName, int channels, uint32_t capacity, uint32_t sampleRate)
+{
+    if (channels <= 0 || channels > SHM_MAX_CHANNELS || capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        cerr << "Invalid shared memory ring geometry" << endl;
+        return false;
+    }
+
+    destroy();
+
+    size_t slotSize = slot_bytes(channels);
+    size_t bytes = sizeof(ShmRingHeader) + slotSize * capacity;
+
+    // Start from a fresh object; readers still mapping the old one are told to reopen
+    retire_ring(shmName);
+    shm_unlink(shmName);
+    int fd = shm_open(shmName, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("shm_open");
+        return false;
+    }
+    if (ftruncate(fd, bytes) != 0)
+    {
+        perror("ftruncate");
+        ::close(fd);
+        shm_unlink(shmName);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(shmName);
+        return false;
+    }
+
+    name = shmName;
+    mappedBytes = bytes;
+    header = static_cast<ShmRingHeader *>(addr);
+    slots = static_cast<uint8_t *>(addr) + sizeof(ShmRingHeader);
+    next = 0;
+
+    header->version = SHM_RING_VERSION;
+    header->header_size = sizeof(ShmRingHeader);
+    header->slot_size = static_cast<uint32_t>(slotSize);
+    header->capacity = capacity;
+    header->channels = static_cast<uint16_t>(channels);
+    header->reserved = 0;
+    header->sample_rate = sampleRate;
+    header->writer_pid = static_cast<uint32_t>(getpid());
+    header->head.store(0, memory_order_relaxed);
+
+    // Publishing the magic marks the header as complete
+    header->magic.store(SHM_RING_MAGIC, memory_order_release);
+    return true;
+}
+
+void ShmRingWriter::destroy()
+{
+    if (!header)
+        return;
+    header->magic.store(0, memory_order_release);
+    munmap(header, mappedBytes);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    slots = nullptr;
+}
+
+void ShmRingWriter::publish(int64_t timestamp_ns, const uint32_t *red, const uint32_t *ir)
+{
+    if (!header)
+        return;
+
+    uint64_t seq = next++;
+    uint8_t *base = slots + (seq & (header->capacity - 1)) * header->slot_size;
+    ShmSlotHeader *slot = reinterpret_cast<ShmSlotHeader *>(base);
+    uint32_t *payload = reinterpret_cast<uint32_t *>(slot + 1);
+
+    slot->seq.store(2 * seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->timestamp_ns = timestamp_ns;
+    memcpy(payload, red, sizeof(uint32_t) * header->channels);
+    memcpy(payload + header->channels, ir, sizeof(uint32_t) * header->channels);
+
+    slot->seq.store(2 * seq + 2, memory_order_release);
+    header->head.store(seq + 1, memory_order_release);
+}
+
+ShmRingReader::ShmRingReader()
+    : header(nullptr), slots(nullptr), mappedBytes(0)
+{
+}
+
+ShmRingReader::~ShmRingReader()
+{
+    close();
+}
+
+bool ShmRingReader::open(const char *shmName)
+{
+    close();
+
+    int fd = shm_open(shmName, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        perror("shm_open");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader))
+    {
+        cerr << "Shared memory ring is not initialised yet" << endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    const ShmRingHeader *h = static_cast<const ShmRingHeader *>(addr);
+    bool valid = h->magic.load(memory_order_acquire) == SHM_RING_MAGIC;
+    valid = valid && h->version == SHM_RING_VERSION && h->header_size == sizeof(ShmRingHeader) &&
+            h->channels <= SHM_MAX_CHANNELS && h->capacity > 0 && (h->capacity & (h->capacity - 1)) == 0 &&
+            static_cast<size_t>(st.st_size) >= h->header_size + static_cast<size_t>(h->slot_size) * h->capacity;
+    if (!valid)
+    {
+        cerr << "Unsupported shared memory ring layout" << endl;
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    header = h;
+    slots = static_cast<const uint8_t *>(addr) + h->header_size;
+    mappedBytes = st.st_size;
+    return true;
+}
+
+void ShmRingReader::close()
+{
+    if (!header)
+        return;
+    munmap(const_cast<ShmRingHeader *>(header), mappedBytes);
+    header = nullptr;
+    slots = nullptr;
+}
+
+uint64_t ShmRingReader::head() const
+{
+    return header ? header->head.load(memory_order_acquire) : 0;
+}
+
+bool ShmRingReader::retired() const
+{
+    return header && header->magic.load(memory_order_acquire) != SHM_RING_MAGIC;
+}
+
+uint64_t ShmRingReader::oldest() const
+{
+    uint64_t h = head();
+    if (!header || h <= header->capacity)
+        return 0;
+    return h - header->capacity + 1;
+}
+
+const ShmSlotHeader *ShmRingReader::slotAt(uint64_t seq) const
+{
+    if (!header)
+        return nullptr;
+    return reinterpret_cast<const ShmSlotHeader *>(slots + (seq & (header->capacity - 1)) * header->slot_size);
+}
+
+bool ShmRingReader::read(uint64_t seq, ShmFrame &out) const
+{
+    out.seq = seq;
+    return visit(seq, [&out](int64_t timestamp_ns, const uint32_t *red, const uint32_t *ir, int channels)
+                 {
+        out.timestamp_ns = timestamp_ns;
+        out.channels = static_cast<uint16_t>(channels);
+        memcpy(out.red, red, sizeof(uint32_t) * channels);
+        memcpy(out.ir, ir, sizeof(uint32_t) * channels); });
+}
@@ -0,0 +1,148 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+// Live frame ring exported through POSIX shared memory (/dev/shm/max30102_frames)
+// so co-located tools can follow the signal without going through the broker.
+//
+// Layout, version 1 (all fields little endian, offsets in bytes):
+//
+//   0   ShmRingHeader (64 bytes)
+//         magic        uint32  'MAXR' (0x5258414D), written last by the creator (atomic)
+//         version      uint16  SHM_RING_VERSION
+//         header_size  uint16  sizeof(ShmRingHeader)
+//         slot_size    uint32  bytes per slot, multiple of 64
+//         capacity     uint32  number of slots, power of two
+//         channels     uint16  channels per frame
+//         reserved     uint16
+//         sample_rate  uint32  nominal frames per second
+//         writer_pid   uint32
+//         head         uint64  number of frames published so far (atomic)
+//   64  slot[capacity], slot_size bytes each:
+//         seq          uint64  seqlock word (atomic), 2 * n + 2 once frame n is complete
+//         timestamp_ns int64   CLOCK_REALTIME of the read
+//         red          uint32[channels]
+//         ir           uint32[channels]
+//
+// Frame n lives in slot n & (capacity - 1). Reader protocol:
+//   1. s1 = slot.seq (acquire); give up if s1 != 2 * n + 2 (odd: being written,
+//      smaller: not yet written, larger: already overwritten)
+//   2. read the payload
+//   3. acquire fence, s2 = slot.seq; the copy is valid only if s2 == s1
+// Readers that fall more than capacity frames behind head have lost data and
+// should resume from head - capacity + 1.
+// Unlinking does not reach readers that have the ring mapped, so the writer
+// clears magic before it removes or replaces a ring, also one left behind by
+// a writer that died. A reader that sees magic change must unmap and reopen.
+
+#define SHM_RING_NAME "/max30102_frames"
+#define SHM_RING_MAGIC 0x5258414Du
+#define SHM_RING_VERSION 1
+#define SHM_MAX_CHANNELS 128
+
+struct ShmRingHeader
+{
+    std::atomic<uint32_t> magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t slot_size;
+    uint32_t capacity;
+    uint16_t channels;
+    uint16_t reserved;
+    uint32_t sample_rate;
+    uint32_t writer_pid;
+    uint32_t padding0;
+    std::atomic<uint64_t> head;
+    uint8_t padding1[24];
+};
+
+struct ShmSlotHeader
+{
+    std::atomic<uint64_t> seq;
+    int64_t timestamp_ns;
+};
+
+struct ShmFrame
+{
+    uint64_t seq;
+    int64_t timestamp_ns;
+    uint16_t channels;
+    uint32_t red[SHM_MAX_CHANNELS];
+    uint32_t ir[SHM_MAX_CHANNELS];
+};
+
+class ShmRingWriter
+{
+public:
+    ShmRingWriter();
+    ~ShmRingWriter();
+
+    bool create(const char *name, int channels, uint32_t capacity, uint32_t sampleRate);
+    void destroy();
+
+    // Single writer only
+    void publish(int64_t timestamp_ns, const uint32_t *red, const uint32_t *ir);
+
+    bool isOpen() const { return header != nullptr; }
+    int channels() const { return header ? header->channels : 0; }
+    uint32_t sampleRate() const { return header ? header->sample_rate : 0; }
+
+private:
+    std::string name;
+    ShmRingHeader *header;
+    uint8_t *slots;
+    size_t mappedBytes;
+    uint64_t next;
+};
+
+class ShmRingReader
+{
+public:
+    ShmRingReader();
+    ~ShmRingReader();
+
+    bool open(const char *name = SHM_RING_NAME);
+    void close();
+
+    uint64_t head() const;
+    uint64_t oldest() const;
+
+    // True once the writer removed or replaced the ring; nothing more will
+    // be published into this mapping, so close() and open() again
+    bool retired() const;
+    int channels() const { return header ? header->channels : 0; }
+    uint32_t sampleRate() const { return header ? header->sample_rate : 0; }
+
+    // Copy frame seq into out; false if it is not written yet or was overwritten
+    bool read(uint64_t seq, ShmFrame &out) const;
+
+    // Zero-copy access: fn(timestamp_ns, red, ir, channels) sees the slot in place.
+    // Anything computed inside fn must be discarded when visit() returns false.
+    template <typename Fn>
+    bool visit(uint64_t seq, Fn fn) const
+    {
+        const ShmSlotHeader *slot = slotAt(seq);
+        uint64_t expected = 2 * seq + 2;
+        if (!slot || slot->seq.load(std::memory_order_acquire) != expected)
+            return false;
+
+        const uint32_t *red = reinterpret_cast<const uint32_t *>(slot + 1);
+        fn(slot->timestamp_ns, red, red + header->channels, header->channels);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->seq.load(std::memory_order_relaxed) == expected;
+    }
+
+private:
+    const ShmSlotHeader *slotAt(uint64_t seq) const;
+
+    const ShmRingHeader *header;
+    const uint8_t *slots;
+    size_t mappedBytes;
+};
+
+#endif // SHMRING_H
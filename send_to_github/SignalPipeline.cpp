@@ -0,0 +1,79 @@
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+SignalPipeline::SignalPipeline()
+    : align(false), suppressMotion(false)
+{
+    memset(&out, 0, sizeof(out));
+}
+
+bool SignalPipeline::configure(int channels, double sampleRate, const ChannelRoles &roles, bool align, bool suppressMotion)
+{
+    memset(&out, 0, sizeof(out));
+    memset(lastQuality, 0, sizeof(lastQuality));
+    out.channels = channels;
+    this->align = align && aligner.setup(channels, sampleRate, 4);
+    this->suppressMotion = suppressMotion;
+    motionStage.configure(channels, sampleRate);
+    qualityStage.configure(channels, sampleRate);
+    vitalsStage.configure(channels, sampleRate);
+    perfusionStage.configure(channels, sampleRate, roles);
+    transitStage.configure(channels, sampleRate, roles);
+    beatStage.configure(channels, sampleRate);
+    return redOutlier.setup(channels) && irOutlier.setup(channels) &&
+           redFilter.setup(channels, sampleRate) && irFilter.setup(channels, sampleRate);
+}
+
+const PipelineFrame &SignalPipeline::process(const MaxData &data)
+{
+    out.timestamp_ns = data.timestamp_ns;
+    if (data.channels != out.channels || redFilter.channels() != out.channels)
+        return out;
+
+    redOutlier.process(data.redData, redFlags, redClean);
+    irOutlier.process(data.irData, irFlags, irClean);
+    for (int i = 0; i < out.channels; i++)
+    {
+        out.quality[i] = static_cast<uint8_t>(redFlags[i] | irFlags[i] << 2);
+        // Only spikes are patched; a saturated run has its own median anyway
+        if (!(redFlags[i] & OUTLIER_SPIKE))
+            redClean[i] = data.redData[i];
+        if (!(irFlags[i] & OUTLIER_SPIKE))
+            irClean[i] = data.irData[i];
+    }
+
+    redFilter.process(redClean, out.redAc, out.redDc);
+    irFilter.process(irClean, out.irAc, out.irDc);
+    for (int i = 0; i < out.channels; i++)
+    {
+        if (out.irDc[i] < SQI_CONTACT_DC)
+            out.quality[i] |= QUALITY_NO_CONTACT;
+    }
+
+    if (align)
+    {
+        // The aligned values are one frame old, and so are their flags
+        float *streams[4] = {out.redAc, out.irAc, out.redDc, out.irDc};
+        int64_t grid;
+        if (aligner.process(data.timestamp_ns, data.offset_ns, streams, streams, grid))
+            out.timestamp_ns = grid;
+        for (int i = 0; i < out.channels; i++)
+            swap(out.quality[i], lastQuality[i]);
+    }
+
+    motionStage.process(out, suppressMotion);
+    qualityStage.process(out);
+    vitalsStage.process(out);
+    perfusionStage.process(out);
+    transitStage.process(out, vitalsStage, qualityStage);
+    beatStage.process(out, vitalsStage, qualityStage);
+    return out;
+}
+
+void SignalPipeline::finish()
+{
+    motionStage.finish();
+}
@@ -0,0 +1,90 @@
+#ifndef SIGNALPIPELINE_H
+#define SIGNALPIPELINE_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+#include "FrameSource.h"
+#include "ChannelFilter.h"
+#include "OutlierDetector.h"
+#include "ChannelAligner.h"
+#include "VitalsEstimator.h"
+#include "PerfusionMonitor.h"
+#include "SignalQuality.h"
+#include "PulseTransit.h"
+#include "BeatFeatures.h"
+#include "MotionDetector.h"
+
+static_assert(FRAME_MAX_CHANNELS <= DSP_MAX_CHANNELS, "signal stages are sized for fewer channels than a frame holds");
+
+// PipelineFrame::quality bits
+#define QUALITY_RED_SPIKE OUTLIER_SPIKE
+#define QUALITY_RED_SATURATED OUTLIER_SATURATED
+#define QUALITY_IR_SPIKE (OUTLIER_SPIKE << 2)
+#define QUALITY_IR_SATURATED (OUTLIER_SATURATED << 2)
+#define QUALITY_NO_CONTACT 0x10 // ir DC below SQI_CONTACT_DC
+#define QUALITY_MOTION 0x20     // in a motion artefact, only set when suppressing them
+
+// Everything the per-frame stages derive from one MaxData frame
+struct PipelineFrame
+{
+    int64_t timestamp_ns;
+    int channels;
+    float redAc[DSP_MAX_CHANNELS], irAc[DSP_MAX_CHANNELS]; // pulse band, counts
+    float redDc[DSP_MAX_CHANNELS], irDc[DSP_MAX_CHANNELS]; // tracked baseline, counts
+    uint8_t quality[DSP_MAX_CHANNELS];                     // QUALITY_* flags of this sample, 0 when clean
+};
+
+// Per-frame signal processing shared by every consumer of a session.
+// configure() at session start, then process() each frame in arrival order.
+// Raw samples flagged as spikes are replaced by their window median before
+// filtering, so one glitch does not ring through the pulse band; the raw data
+// itself is left alone for the recording and the upload.
+// With align set, the filtered channels are resampled onto a common time grid
+// before the analysis stages, one frame later than without.
+// Motion artefacts are always detected; with suppressMotion set, their samples
+// are flagged QUALITY_MOTION and the analysis stages leave them out.
+class SignalPipeline
+{
+public:
+    SignalPipeline();
+
+    bool configure(int channels, double sampleRate, const ChannelRoles &roles, bool align = false, bool suppressMotion = false);
+
+    const PipelineFrame &process(const MaxData &data);
+
+    // End of the session: stages with a record in progress queue it
+    void finish();
+    const PipelineFrame &frame() const { return out; }
+    bool aligned() const { return align; }
+    bool suppressesMotion() const { return suppressMotion; }
+    const MotionDetector &motion() const { return motionStage; }
+    const VitalsEstimator &vitals() const { return vitalsStage; }
+    const PerfusionMonitor &perfusion() const { return perfusionStage; }
+    const SignalQuality &signalQuality() const { return qualityStage; }
+    const PulseTransit &transit() const { return transitStage; }
+    const BeatFeatures &beats() const { return beatStage; }
+    const OutlierDetector &redOutliers() const { return redOutlier; }
+    const OutlierDetector &irOutliers() const { return irOutlier; }
+
+private:
+    OutlierDetector redOutlier;
+    OutlierDetector irOutlier;
+    ChannelFilterBank redFilter;
+    ChannelFilterBank irFilter;
+    ChannelAligner aligner;
+    MotionDetector motionStage;
+    SignalQuality qualityStage;
+    VitalsEstimator vitalsStage;
+    PerfusionMonitor perfusionStage;
+    PulseTransit transitStage;
+    BeatFeatures beatStage;
+
+    PipelineFrame out;
+    bool align;
+    bool suppressMotion;
+    uint8_t lastQuality[DSP_MAX_CHANNELS];
+    uint8_t redFlags[DSP_MAX_CHANNELS], irFlags[DSP_MAX_CHANNELS];
+    uint32_t redClean[DSP_MAX_CHANNELS], irClean[DSP_MAX_CHANNELS];
+};
+
+#endif // SIGNALPIPELINE_H
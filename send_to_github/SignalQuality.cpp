@@ -0,0 +1,153 @@
+#include "SignalQuality.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+SignalQuality::SignalQuality()
+{
+    configure(0, 1);
+}
+
+void SignalQuality::configure(int channels, double sampleRate)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    blockLength = max(1, static_cast<int>(lround(sampleRate * SQI_BLOCK_SECONDS)));
+    blockFill = 0;
+    blocksDone = 0;
+
+    decimation = max(1, static_cast<int>(lround(sampleRate / SQI_SPECTRUM_HZ)));
+    decimationFill = 0;
+    historyNext = 0;
+    historyFilled = 0;
+
+    resolution = sampleRate / decimation / SQI_SPECTRUM_SIZE;
+    binLow = max(1, static_cast<int>(ceil(SQI_BAND_LOW_HZ / resolution)));
+    binHigh = min(SQI_SPECTRUM_SIZE / 2 - 1, static_cast<int>(SQI_BAND_HIGH_HZ / resolution));
+
+    for (int n = 0; n < SQI_SPECTRUM_SIZE; n++)
+        window[n] = static_cast<float>(0.5 - 0.5 * cos(2 * M_PI * n / SQI_SPECTRUM_SIZE));
+
+    memset(noContact, 0, sizeof(noContact));
+    memset(clipped, 0, sizeof(clipped));
+    memset(moving, 0, sizeof(moving));
+    memset(decimationSum, 0, sizeof(decimationSum));
+    memset(history, 0, sizeof(history));
+    memset(snrDb, 0, sizeof(snrDb));
+    memset(peakBpm, 0, sizeof(peakBpm));
+    for (int i = 0; i < DSP_MAX_CHANNELS; i++)
+    {
+        levels[i] = SIGNAL_GOOD;
+        contactRatio[i] = 1;
+        clippingRatio[i] = 0;
+        motionRatio[i] = 0;
+    }
+}
+
+void SignalQuality::process(const PipelineFrame &frame)
+{
+    for (int ch = 0; ch < count; ch++)
+    {
+        uint8_t q = frame.quality[ch];
+        if (q & QUALITY_NO_CONTACT)
+            noContact[ch]++;
+        if (q & (QUALITY_RED_SATURATED | QUALITY_IR_SATURATED))
+            clipped[ch]++;
+        if (q & QUALITY_MOTION)
+            moving[ch]++;
+        decimationSum[ch] += frame.irAc[ch];
+    }
+
+    if (++decimationFill == decimation)
+    {
+        float scale = 1.0f / decimation;
+        float *row = history[historyNext];
+        for (int ch = 0; ch < count; ch++)
+        {
+            row[ch] = decimationSum[ch] * scale;
+            decimationSum[ch] = 0;
+        }
+        decimationFill = 0;
+        historyNext = (historyNext + 1) % SQI_SPECTRUM_SIZE;
+        historyFilled = min(historyFilled + 1, SQI_SPECTRUM_SIZE);
+    }
+
+    if (++blockFill == blockLength)
+        closeBlock();
+}
+
+void SignalQuality::closeBlock()
+{
+    bool ready = spectrumReady() && binHigh > binLow;
+    if (ready)
+        analyseSpectrum();
+
+    for (int ch = 0; ch < count; ch++)
+    {
+        contactRatio[ch] = 1.0f - static_cast<float>(noContact[ch]) / blockLength;
+        clippingRatio[ch] = static_cast<float>(clipped[ch]) / blockLength;
+        motionRatio[ch] = static_cast<float>(moving[ch]) / blockLength;
+
+        if (contactRatio[ch] < 1 - SQI_DEAD_RATIO || clippingRatio[ch] > SQI_DEAD_RATIO)
+            levels[ch] = SIGNAL_DEAD;
+        else if (clippingRatio[ch] > SQI_POOR_CLIPPING || motionRatio[ch] > SQI_POOR_MOTION || (ready && snrDb[ch] < SQI_POOR_SNR_DB))
+            levels[ch] = SIGNAL_POOR;
+        else
+            levels[ch] = SIGNAL_GOOD;
+    }
+
+    blockFill = 0;
+    blocksDone++;
+    memset(noContact, 0, sizeof(noContact));
+    memset(clipped, 0, sizeof(clipped));
+    memset(moving, 0, sizeof(moving));
+}
+
+// Hann-windowed spectrum of every channel's history, oldest sample first
+void SignalQuality::analyseSpectrum()
+{
+    for (int n = 0; n < SQI_SPECTRUM_SIZE; n++)
+    {
+        const float *in = history[(historyNext + n) % SQI_SPECTRUM_SIZE];
+        float *out = windowed[n];
+        float w = window[n];
+        for (int ch = 0; ch < count; ch++)
+            out[ch] = in[ch] * w;
+    }
+    fft.power(&windowed[0][0], count, &power[0][0]);
+
+    for (int ch = 0; ch < count; ch++)
+    {
+        int peak = binLow;
+        for (int k = binLow; k <= binHigh; k++)
+        {
+            if (power[k][ch] > power[peak][ch])
+                peak = k;
+        }
+
+        // The Hann main lobe spans three bins; count the harmonic as pulse as well
+        double signal = 0, total = 0;
+        for (int k = binLow; k <= binHigh; k++)
+        {
+            total += power[k][ch];
+            if (abs(k - peak) <= 1 || abs(k - 2 * peak) <= 1)
+                signal += power[k][ch];
+        }
+
+        double noise = total - signal;
+        if (signal <= 0)
+            snrDb[ch] = 0;
+        else if (noise <= signal * 1e-6)
+            snrDb[ch] = 60;
+        else
+            snrDb[ch] = static_cast<float>(10 * log10(signal / noise));
+
+        // Parabolic interpolation between the neighbouring bins
+        double left = power[peak - 1][ch], centre = power[peak][ch], right = power[peak + 1][ch];
+        double curve = left - 2 * centre + right;
+        double offset = curve < 0 ? 0.5 * (left - right) / curve : 0;
+        peakBpm[ch] = signal > 0 ? static_cast<float>(60 * (peak + offset) * resolution) : 0;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef SIGNALQUALITY_H
+#define SIGNALQUALITY_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+#include "RealFft.h"
+
+#define SQI_CONTACT_DC 10000      // counts of ir DC; below this the probe sees no tissue
+#define SQI_BLOCK_SECONDS 1
+#define SQI_SPECTRUM_HZ 25        // rate the pulse band is decimated to for the spectrum
+#define SQI_SPECTRUM_SIZE 256     // decimated samples per spectrum, about 10 s
+#define SQI_BAND_LOW_HZ 0.5
+#define SQI_BAND_HIGH_HZ 4.0
+#define SQI_DEAD_RATIO 0.5        // share of a block without contact or clipped that makes it dead
+#define SQI_POOR_CLIPPING 0.05
+#define SQI_POOR_SNR_DB 3.0
+#define SQI_POOR_MOTION 0.2      // share of a block flagged as motion, when motion is suppressed
+
+struct PipelineFrame;
+
+enum SignalLevel
+{
+    SIGNAL_DEAD, // no contact or saturated: not worth plotting or publishing; still uploaded, tagged
+    SIGNAL_POOR, // usable but the numbers derived from it should not be trusted
+    SIGNAL_GOOD
+};
+
+// Signal quality index per channel, one result per SQI_BLOCK_SECONDS block.
+// Contact, clipping and motion are the shares of the block's samples that
+// carry the QUALITY_NO_CONTACT, saturation and QUALITY_MOTION flags. The spectral measure is the power
+// around the strongest pulse-band peak and its first harmonic over the rest
+// of the band, from the last SQI_SPECTRUM_SIZE samples of the ir pulse band
+// after boxcar decimation to SQI_SPECTRUM_HZ. Windows overlap by all but one
+// block and all channels go through one batched FFT. The same peak gives a
+// frequency-domain heart rate, which holds up under motion better than beat
+// picking. Until the history is full only contact and clipping decide the
+// level. Channels start out good, so nothing is dropped before the first
+// block closes.
+class SignalQuality
+{
+public:
+    SignalQuality();
+
+    void configure(int channels, double sampleRate);
+    void process(const PipelineFrame &frame);
+
+    SignalLevel level(int ch) const { return levels[ch]; }
+    float contact(int ch) const { return contactRatio[ch]; }
+    float clipping(int ch) const { return clippingRatio[ch]; }
+    float motion(int ch) const { return motionRatio[ch]; }
+    float peakToNoise(int ch) const { return snrDb[ch]; }     // dB, 0 until the spectrum is ready
+    float spectralRate(int ch) const { return peakBpm[ch]; } // beats per minute, 0 until ready
+    bool spectrumReady() const { return historyFilled == SQI_SPECTRUM_SIZE; }
+
+    // Increments each time a block closes
+    uint32_t updates() const { return blocksDone; }
+
+private:
+    typedef RealFft<SQI_SPECTRUM_SIZE> Fft;
+
+    void closeBlock();
+    void analyseSpectrum();
+
+    int count;
+    int blockLength;
+    int blockFill;
+    uint32_t blocksDone;
+
+    int decimation;
+    int decimationFill;
+    int historyNext;
+    int historyFilled;
+    double resolution; // Hz per bin
+    int binLow, binHigh;
+    float window[SQI_SPECTRUM_SIZE];
+
+    uint32_t noContact[DSP_MAX_CHANNELS];
+    uint32_t clipped[DSP_MAX_CHANNELS];
+    uint32_t moving[DSP_MAX_CHANNELS];
+    float decimationSum[DSP_MAX_CHANNELS];
+    alignas(16) float history[SQI_SPECTRUM_SIZE][DSP_MAX_CHANNELS];
+    alignas(16) float windowed[SQI_SPECTRUM_SIZE][DSP_MAX_CHANNELS];
+    alignas(16) float power[Fft::Bins][DSP_MAX_CHANNELS];
+    Fft fft;
+
+    SignalLevel levels[DSP_MAX_CHANNELS];
+    float contactRatio[DSP_MAX_CHANNELS];
+    float clippingRatio[DSP_MAX_CHANNELS];
+    float motionRatio[DSP_MAX_CHANNELS];
+    float snrDb[DSP_MAX_CHANNELS];
+    float peakBpm[DSP_MAX_CHANNELS];
+};
+
+#endif // SIGNALQUALITY_H
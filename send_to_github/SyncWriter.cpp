@@ -0,0 +1,141 @@
+#include "SyncWriter.h"
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+
+using namespace std;
+
+#define SYNC_WRITER_SPARE 4 // spent buffers kept for reuse
+
+bool write_all(int fd, const void *data, size_t len)
+{
+    const char *p = static_cast<const char *>(data);
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+SyncWriter::SyncWriter()
+    : fd(-1), error(false), stopping(false)
+{
+}
+
+SyncWriter::~SyncWriter()
+{
+    finish();
+}
+
+void SyncWriter::start(int file, const string &name)
+{
+    finish();
+
+    fd = file;
+    what = name;
+    error = false;
+    stopping = false;
+    worker = thread(&SyncWriter::run, this);
+}
+
+bool SyncWriter::write(vector<uint8_t> &data)
+{
+    if (!isOpen() || error)
+        return false;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        queue.push_back(vector<uint8_t>());
+        queue.back().swap(data);
+        if (!spare.empty())
+        {
+            data.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    queueCond.notify_one();
+    data.clear();
+    return true;
+}
+
+bool SyncWriter::write(const void *data, size_t len)
+{
+    vector<uint8_t> buffer;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (!spare.empty())
+        {
+            buffer.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    buffer.assign(bytes, bytes + len);
+    return write(buffer);
+}
+
+bool SyncWriter::finish()
+{
+    if (!isOpen())
+        return true;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCond.notify_one();
+    worker.join();
+
+    if (::close(fd) != 0 && !error)
+    {
+        perror(("Failed to close " + what).c_str());
+        error = true;
+    }
+    fd = -1;
+    queue.clear();
+    return !error;
+}
+
+void SyncWriter::run()
+{
+    deque<vector<uint8_t> > batch;
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        queueCond.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            break;
+
+        batch.swap(queue);
+        lock.unlock();
+
+        // After a failure the rest is dropped; the file keeps what was synced before it
+        if (!error)
+        {
+            bool ok = true;
+            for (size_t i = 0; i < batch.size() && ok; i++)
+                ok = write_all(fd, batch[i].data(), batch[i].size());
+            if (!ok || fdatasync(fd) != 0)
+            {
+                perror(("Failed to write " + what).c_str());
+                error = true;
+            }
+        }
+
+        lock.lock();
+        while (!batch.empty())
+        {
+            if (spare.size() < SYNC_WRITER_SPARE)
+                spare.push_back(std::move(batch.front()));
+            batch.pop_front();
+        }
+    }
+}
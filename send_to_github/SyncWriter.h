@@ -0,0 +1,62 @@
+#ifndef SYNCWRITER_H
+#define SYNCWRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes all of data to fd, retrying short writes and EINTR; false on any other error
+bool write_all(int fd, const void *data, size_t len);
+
+// Appends buffers to a file from a thread of its own, each batch followed by
+// fdatasync, so the thread producing the data never waits on the disk.
+// Buffers reach the file in the order they were handed over; whatever was
+// queued while a sync ran goes out together with one sync after it. Spent
+// buffers are kept and handed back through write(), so a steady stream of
+// blocks does not allocate.
+class SyncWriter
+{
+public:
+    SyncWriter();
+    ~SyncWriter();
+
+    // Takes over fd; what names the file in error messages
+    void start(int fd, const std::string &what);
+
+    // Queues data and swaps a spent buffer (empty) into it.
+    // False once an earlier write or sync has failed.
+    bool write(std::vector<uint8_t> &data);
+    bool write(const void *data, size_t len);
+
+    // Waits for everything queued to be written and synced, then closes the
+    // file; false when any write or sync failed
+    bool finish();
+
+    bool isOpen() const { return worker.joinable(); }
+    bool failed() const { return error; }
+
+private:
+    SyncWriter(const SyncWriter &) = delete;
+    SyncWriter &operator=(const SyncWriter &) = delete;
+
+    void run();
+
+    int fd;
+    std::string what;
+    std::thread worker;
+    std::atomic<bool> error;
+
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<std::vector<uint8_t> > queue;
+    std::vector<std::vector<uint8_t> > spare;
+    bool stopping;
+};
+
+#endif // SYNCWRITER_H
@@ -0,0 +1,192 @@
+#include "SyntheticSource.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+SyntheticConfig SyntheticConfig::standard(int channels, uint32_t sampleRate)
+{
+    SyntheticConfig config;
+    config.channels = max(1, min(channels, FRAME_MAX_CHANNELS));
+    config.sampleRate = max<uint32_t>(1, min<uint32_t>(sampleRate, SYNTH_MAX_RATE_HZ));
+    config.seconds = 5;
+    config.speed = 1.0;
+    config.skew = 0;
+    config.seed = 1;
+
+    for (int i = 0; i < config.channels; i++)
+    {
+        SyntheticChannel ch;
+        ch.heartRate = 60 + (i * 7) % 41;
+        ch.perfusion = 0.005 + 0.005 * (i % 5);
+        ch.spo2 = 94 + i % 6;
+        ch.level = 60000 + (i * 9973) % 120000;
+        ch.noise = 40;
+        ch.motionPerMinute = i % 4 == 3 ? 2 : 0;
+        ch.motionAmplitude = 0.05 * ch.level;
+        ch.dropoutPerMinute = i % 8 == 7 ? 0.5 : 0;
+        ch.dropoutSeconds = 1.5;
+        config.channel.push_back(ch);
+    }
+    return config;
+}
+
+SyntheticConfig SyntheticConfig::fromEnvironment()
+{
+    const char *channels = getenv(SYNTH_CHANNELS_ENV);
+    const char *rate = getenv(SYNTH_RATE_ENV);
+    const char *seconds = getenv(SYNTH_SECONDS_ENV);
+    const char *speed = getenv(SYNTH_SPEED_ENV);
+    const char *skew = getenv(SYNTH_SKEW_ENV);
+
+    SyntheticConfig config = standard(channels ? atoi(channels) : 8, rate ? atoi(rate) : 100);
+    if (seconds)
+        config.seconds = atof(seconds);
+    if (speed)
+        config.speed = atof(speed);
+    if (skew)
+        config.skew = atof(skew) / 1e6;
+    return config;
+}
+
+SyntheticSource::SyntheticSource(const SyntheticConfig &config, QObject *parent)
+    : FrameSource(parent), config(config), rng(config.seed), gauss(0.0, 1.0), uniform(0.0, 1.0),
+      pacer(config.speed)
+{
+    this->config.channels = max(1, min(this->config.channels, FRAME_MAX_CHANNELS));
+    this->config.sampleRate = max<uint32_t>(1, min<uint32_t>(this->config.sampleRate, SYNTH_MAX_RATE_HZ));
+    // Channels without their own model get the standard one
+    SyntheticConfig defaults = SyntheticConfig::standard(this->config.channels, this->config.sampleRate);
+    for (size_t i = this->config.channel.size(); i < defaults.channel.size(); i++)
+        this->config.channel.push_back(defaults.channel[i]);
+
+    // One beat: systolic peak plus a smaller dicrotic wave
+    for (int i = 0; i < SYNTH_PULSE_TABLE; i++)
+    {
+        double x = static_cast<double>(i) / SYNTH_PULSE_TABLE;
+        double systolic = (x - 0.25) / 0.08;
+        double dicrotic = (x - 0.55) / 0.10;
+        pulse[i] = exp(-0.5 * systolic * systolic) + 0.4 * exp(-0.5 * dicrotic * dicrotic);
+    }
+}
+
+RecordingProfile SyntheticSource::profile() const
+{
+    RecordingProfile profile;
+    profile.sensor = "SYNTHETIC";
+    profile.sample_rate = config.sampleRate;
+    profile.channels = config.channels;
+    profile.mode_config = profile.spo2_config = profile.fifo_config = 0;
+    profile.red_led = profile.ir_led = profile.pilot_pa = 0;
+    return profile;
+}
+
+void SyntheticSource::generate(MaxData &data, double t)
+{
+    double dt = 1.0 / config.sampleRate;
+    // Breathing moves the baseline of every channel together
+    double breathing = 1.0 + 0.01 * sin(2 * M_PI * 0.25 * t);
+
+    for (int i = 0; i < config.channels; i++)
+    {
+        const SyntheticChannel &ch = config.channel[i];
+        ChannelState &s = state[i];
+
+        // Beat to beat variability as a slow random walk around the set rate
+        s.heartRate += 0.02 * gauss(rng) - 0.001 * (s.heartRate - ch.heartRate);
+        s.phase += s.heartRate / 60.0 * dt;
+        s.phase -= floor(s.phase);
+        // Read i * skew after the frame time, so the pulse is that much further on
+        double phase = s.phase + s.heartRate / 60.0 * config.skew * i;
+        double p = pulse[static_cast<int>((phase - floor(phase)) * SYNTH_PULSE_TABLE) % SYNTH_PULSE_TABLE];
+
+        // Ratio of ratios from the usual linear calibration SpO2 = 110 - 25 R
+        double ratio = (110.0 - ch.spo2) / 25.0;
+        double irLevel = ch.level * breathing;
+        double redLevel = 0.7 * irLevel;
+        double ir = irLevel * (1.0 - ch.perfusion * p);
+        double red = redLevel * (1.0 - ch.perfusion * ratio * p);
+
+        if (s.motionLeft <= 0 && ch.motionPerMinute > 0 && uniform(rng) < ch.motionPerMinute / 60.0 * dt)
+        {
+            s.motionLength = s.motionLeft = 0.5 + 1.5 * uniform(rng);
+            s.motionFreq = 0.5 + 2.5 * uniform(rng);
+            s.motionAmp = ch.motionAmplitude * (0.5 + 0.5 * uniform(rng));
+        }
+        if (s.motionLeft > 0)
+        {
+            double elapsed = s.motionLength - s.motionLeft;
+            double m = s.motionAmp * sin(M_PI * elapsed / s.motionLength) * sin(2 * M_PI * s.motionFreq * elapsed);
+            ir += m;
+            red += 0.7 * m;
+            s.motionLeft -= dt;
+        }
+
+        if (s.dropoutLeft <= 0 && ch.dropoutPerMinute > 0 && uniform(rng) < ch.dropoutPerMinute / 60.0 * dt)
+            s.dropoutLeft = ch.dropoutSeconds;
+        if (s.dropoutLeft > 0)
+        {
+            // Lifted off the skin: only ambient light reaches the photodiode
+            ir = red = 1000;
+            s.dropoutLeft -= dt;
+        }
+
+        ir += ch.noise * gauss(rng);
+        red += ch.noise * gauss(rng);
+
+        data.irData[i] = static_cast<uint32_t>(min<double>(max(ir, 0.0), SYNTH_ADC_MAX));
+        data.redData[i] = static_cast<uint32_t>(min<double>(max(red, 0.0), SYNTH_ADC_MAX));
+    }
+}
+
+void SyntheticSource::run()
+{
+    rng.seed(config.seed);
+    state.assign(config.channels, ChannelState());
+    for (int i = 0; i < config.channels; i++)
+    {
+        state[i].heartRate = config.channel[i].heartRate;
+        state[i].phase = uniform(rng);
+    }
+
+    MaxData data;
+    memset(&data, 0, sizeof(data));
+    data.channels = config.channels;
+    for (int i = 0; i < data.channels; i++)
+    {
+        data.channel_id[i] = i;
+        data.offset_ns[i] = static_cast<int32_t>(llround(config.skew * i * 1e9));
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t start = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    uint64_t total = config.seconds > 0 ? static_cast<uint64_t>(config.seconds * config.sampleRate) : UINT64_MAX;
+
+    pacer.start();
+    for (uint64_t n = 0; n < total; n++)
+    {
+        int64_t offset = static_cast<int64_t>(n * 1000000000ULL / config.sampleRate);
+        if (!pacer.wait(offset))
+            break;
+
+        data.timestamp_ns = start + offset;
+        generate(data, offset / 1e9);
+        emitFrame(data);
+    }
+    pacer.report("Generated");
+}
+
+void SyntheticSource::Quit()
+{
+    pacer.quit();
+}
+
+void SyntheticSource::frameHandled()
+{
+    pacer.handled();
+}
@@ -0,0 +1,93 @@
+#ifndef SYNTHETICSOURCE_H
+#define SYNTHETICSOURCE_H
+
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "FrameSource.h"
+
+// Selects the generator instead of the sensor chain: COLLECT_SYNTHETIC=<channels>,
+// optionally COLLECT_SYNTHETIC_RATE=<Hz>, COLLECT_SYNTHETIC_SECONDS=<session length>
+// and COLLECT_SYNTHETIC_SPEED=<factor> (1 real time, 0 as fast as possible);
+// COLLECT_SYNTHETIC_SKEW_US=<us> reads each channel that much after the previous one
+#define SYNTH_CHANNELS_ENV "COLLECT_SYNTHETIC"
+#define SYNTH_RATE_ENV "COLLECT_SYNTHETIC_RATE"
+#define SYNTH_SECONDS_ENV "COLLECT_SYNTHETIC_SECONDS"
+#define SYNTH_SPEED_ENV "COLLECT_SYNTHETIC_SPEED"
+#define SYNTH_SKEW_ENV "COLLECT_SYNTHETIC_SKEW_US"
+
+#define SYNTH_MAX_RATE_HZ 3200
+#define SYNTH_ADC_MAX 262143 // 18-bit full scale; readings clip here like the real ADC
+#define SYNTH_PULSE_TABLE 1024
+
+// Signal model of one channel
+struct SyntheticChannel
+{
+    double heartRate;        // beats per minute
+    double perfusion;        // pulsatile share of the ir level, e.g. 0.02 for a 2 % perfusion index
+    double spo2;             // percent; sets the red pulse through the ratio of ratios
+    double level;            // ir baseline in counts, red sits at 70 % of it; near SYNTH_ADC_MAX it saturates
+    double noise;            // white noise sigma in counts
+    double motionPerMinute;  // motion artefact bursts per minute
+    double motionAmplitude;  // counts at the peak of a burst
+    double dropoutPerMinute; // sensor lift-offs per minute
+    double dropoutSeconds;   // length of a lift-off
+};
+
+struct SyntheticConfig
+{
+    int channels;
+    uint32_t sampleRate;
+    double seconds; // session length, 0 runs until Quit()
+    double speed;   // 1 real time, N faster, 0 as fast as the consumer keeps up
+    double skew;    // seconds between the reads of neighbouring channels, like a mux walk
+    uint32_t seed;
+    std::vector<SyntheticChannel> channel;
+
+    // A plausible mix across channels: heart rate, perfusion and level vary
+    // per channel, every fourth channel sees motion, every eighth drops out
+    static SyntheticConfig standard(int channels, uint32_t sampleRate);
+
+    static SyntheticConfig fromEnvironment();
+};
+
+// PPG generator for load tests without hardware.
+// Output is a function of the config and seed only; timestamps advance by exactly
+// one sample period from the start of the session.
+class SyntheticSource : public FrameSource
+{
+    Q_OBJECT
+public:
+    explicit SyntheticSource(const SyntheticConfig &config, QObject *parent = nullptr);
+
+    RecordingProfile profile() const override;
+    void run() override;
+    void Quit() override;
+    void frameHandled() override;
+
+private:
+    struct ChannelState
+    {
+        double phase; // position in the current beat, 0..1
+        double heartRate;
+        double motionLeft;
+        double motionLength;
+        double motionFreq;
+        double motionAmp;
+        double dropoutLeft;
+    };
+
+    void generate(MaxData &data, double t);
+
+    SyntheticConfig config;
+    std::vector<ChannelState> state;
+    double pulse[SYNTH_PULSE_TABLE];
+
+    std::mt19937 rng;
+    std::normal_distribution<double> gauss;
+    std::uniform_real_distribution<double> uniform;
+
+    FramePacer pacer;
+};
+
+#endif // SYNTHETICSOURCE_H
@@ -0,0 +1,292 @@
+#include "UploadStore.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// 'UPCK' chunks are header and columns. 'UPCQ' chunks put a uint32 channel
+// count after the header and one quality byte per channel after the columns.
+static const uint32_t CHUNK_MAGIC = 0x4B435055;         // 'UPCK'
+static const uint32_t CHUNK_MAGIC_QUALITY = 0x51435055; // 'UPCQ'
+
+struct ChunkHeader
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t checksum;
+};
+
+static uint32_t fnv1a(const void *data, size_t len, uint32_t hash = 2166136261u)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool make_dirs(const string &path)
+{
+    string current;
+    size_t pos = 0;
+    while (pos != string::npos)
+    {
+        pos = path.find('/', pos + 1);
+        current = path.substr(0, pos);
+        if (current.empty())
+            continue;
+        if (mkdir(current.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            perror("Failed to create upload spool directory");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Writes a complete file next to path and renames it over, so readers see old or new, never half
+static bool write_atomic(const string &path, const void *data, size_t len)
+{
+    string tmp = path + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp)
+    {
+        perror("Failed to write upload spool file");
+        return false;
+    }
+    bool ok = fwrite(data, 1, len, fp) == len;
+    ok = fflush(fp) == 0 && ok;
+    ok = fdatasync(fileno(fp)) == 0 && ok;
+    fclose(fp);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        perror("Failed to write upload spool file");
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+UploadStore::UploadStore(const string &root)
+    : root(root)
+{
+}
+
+string UploadStore::sessionDir(const string &sample_id, const string &start_unix) const
+{
+    // sample_id comes from the QR code, keep it to one path component
+    string name = sample_id + "_" + start_unix;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        if (name[i] == '/' || name[i] == '\\')
+            name[i] = '_';
+    }
+    if (name.empty() || name == "." || name == "..")
+        name = "_";
+    return root + "/" + name;
+}
+
+vector<string> UploadStore::listSessions() const
+{
+    vector<string> dirs;
+    DIR *d = opendir(root.c_str());
+    if (!d)
+        return dirs;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        string dir = root + "/" + entry->d_name;
+        struct stat st;
+        if (stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            dirs.push_back(dir);
+    }
+    closedir(d);
+    sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
+bool UploadStore::saveMeta(const string &dir, const UploadMeta &meta)
+{
+    if (!make_dirs(dir))
+        return false;
+
+    string text = "sample_id=" + meta.sample_id + "\n" +
+                  "user_uuid=" + meta.user_uuid + "\n" +
+                  "start_unix=" + meta.start_unix + "\n" +
+                  "frequency=" + to_string(meta.frequency) + "\n" +
+                  "chunks=" + to_string(meta.chunks) + "\n" +
+                  "committed=" + (meta.committed ? "1" : "0") + "\n";
+    return write_atomic(dir + "/session", text.data(), text.size());
+}
+
+bool UploadStore::loadMeta(const string &dir, UploadMeta &meta) const
+{
+    FILE *fp = fopen((dir + "/session").c_str(), "r");
+    if (!fp)
+        return false;
+
+    meta = UploadMeta();
+    meta.frequency = 0;
+    meta.chunks = 0;
+    meta.committed = false;
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp))
+    {
+        string entry(line);
+        while (!entry.empty() && (entry.back() == '\n' || entry.back() == '\r'))
+            entry.pop_back();
+        size_t eq = entry.find('=');
+        if (eq == string::npos)
+            continue;
+        string key = entry.substr(0, eq);
+        string value = entry.substr(eq + 1);
+
+        if (key == "sample_id")
+            meta.sample_id = value;
+        else if (key == "user_uuid")
+            meta.user_uuid = value;
+        else if (key == "start_unix")
+            meta.start_unix = value;
+        else if (key == "frequency")
+            meta.frequency = atoi(value.c_str());
+        else if (key == "chunks")
+            meta.chunks = atoi(value.c_str());
+        else if (key == "committed")
+            meta.committed = value == "1";
+    }
+    fclose(fp);
+    return !meta.sample_id.empty();
+}
+
+string UploadStore::chunkPath(const string &dir, int seq, bool acked) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%08d.%s", seq, acked ? "acked" : "chunk");
+    return dir + name;
+}
+
+bool UploadStore::writeChunk(const string &dir, int seq, const int32_t *channel, const int32_t *red, const int32_t *ir, size_t count,
+                             const uint8_t *quality, int channels)
+{
+    if (!make_dirs(dir))
+        return false;
+
+    size_t columnBytes = count * sizeof(int32_t);
+    uint32_t qualityCount = static_cast<uint32_t>(channels);
+    vector<char> data(sizeof(ChunkHeader) + sizeof(qualityCount) + 3 * columnBytes + qualityCount);
+
+    char *payload = data.data() + sizeof(ChunkHeader) + sizeof(qualityCount);
+    memcpy(payload, channel, columnBytes);
+    memcpy(payload + columnBytes, red, columnBytes);
+    memcpy(payload + 2 * columnBytes, ir, columnBytes);
+    memcpy(payload + 3 * columnBytes, quality, qualityCount);
+
+    ChunkHeader header;
+    header.magic = CHUNK_MAGIC_QUALITY;
+    header.seq = static_cast<uint32_t>(seq);
+    header.count = static_cast<uint32_t>(count);
+    header.checksum = fnv1a(payload, 3 * columnBytes + qualityCount);
+    memcpy(data.data(), &header, sizeof(header));
+    memcpy(data.data() + sizeof(header), &qualityCount, sizeof(qualityCount));
+
+    return write_atomic(chunkPath(dir, seq, false), data.data(), data.size());
+}
+
+bool UploadStore::readChunk(const string &dir, int seq, UploadChunk &chunk) const
+{
+    FILE *fp = fopen(chunkPath(dir, seq, false).c_str(), "rb");
+    if (!fp)
+        fp = fopen(chunkPath(dir, seq, true).c_str(), "rb");
+    if (!fp)
+        return false;
+
+    ChunkHeader header;
+    uint32_t qualityCount = 0;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              (header.magic == CHUNK_MAGIC || header.magic == CHUNK_MAGIC_QUALITY) &&
+              header.seq == static_cast<uint32_t>(seq);
+    if (ok && header.magic == CHUNK_MAGIC_QUALITY)
+        ok = fread(&qualityCount, sizeof(qualityCount), 1, fp) == 1 && qualityCount <= 0xFFFF;
+    if (ok)
+    {
+        size_t count = header.count;
+        chunk.seq = seq;
+        chunk.channel.resize(count);
+        chunk.red.resize(count);
+        chunk.ir.resize(count);
+        vector<uint8_t> quality(qualityCount);
+        ok = fread(chunk.channel.data(), sizeof(int32_t), count, fp) == count &&
+             fread(chunk.red.data(), sizeof(int32_t), count, fp) == count &&
+             fread(chunk.ir.data(), sizeof(int32_t), count, fp) == count &&
+             fread(quality.data(), 1, qualityCount, fp) == qualityCount;
+
+        uint32_t hash = fnv1a(chunk.channel.data(), count * sizeof(int32_t));
+        hash = fnv1a(chunk.red.data(), count * sizeof(int32_t), hash);
+        hash = fnv1a(chunk.ir.data(), count * sizeof(int32_t), hash);
+        hash = fnv1a(quality.data(), qualityCount, hash);
+        ok = ok && hash == header.checksum;
+        chunk.quality.assign(quality.begin(), quality.end());
+    }
+    fclose(fp);
+
+    if (!ok)
+        fprintf(stderr, "Upload chunk %d in %s is damaged\n", seq, dir.c_str());
+    return ok;
+}
+
+bool UploadStore::markAcked(const string &dir, int seq)
+{
+    return rename(chunkPath(dir, seq, false).c_str(), chunkPath(dir, seq, true).c_str()) == 0;
+}
+
+vector<int> UploadStore::listChunks(const string &dir, bool includeAcked) const
+{
+    vector<int> seqs;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return seqs;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        const char *name = entry->d_name;
+        const char *dot = strchr(name, '.');
+        if (!dot || dot == name)
+            continue;
+        if (strcmp(dot, ".chunk") == 0 || (includeAcked && strcmp(dot, ".acked") == 0))
+            seqs.push_back(atoi(name));
+    }
+    closedir(d);
+    sort(seqs.begin(), seqs.end());
+    return seqs;
+}
+
+void UploadStore::removeSession(const string &dir)
+{
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        unlink((dir + "/" + entry->d_name).c_str());
+    }
+    closedir(d);
+    rmdir(dir.c_str());
+}
@@ -0,0 +1,64 @@
+#ifndef UPLOADSTORE_H
+#define UPLOADSTORE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define UPLOAD_SPOOL_DIR "spool/upload"
+
+struct UploadChunk
+{
+    int seq;
+    std::vector<int> channel;
+    std::vector<int> red;
+    std::vector<int> ir;
+    std::vector<int> quality; // per channel, empty for chunks spooled before it was kept
+};
+
+struct UploadMeta
+{
+    std::string sample_id;
+    std::string user_uuid;
+    std::string start_unix;
+    int frequency;
+    int chunks;     // chunks written so far
+    bool committed; // finish() was reached, chunks is final
+};
+
+// On-disk copy of sessions that are not fully uploaded yet.
+// One directory per session (sample_id and start time, so measuring the same
+// sample again never mixes with chunks still pending from the last time)
+// holds a "session" meta file and one file per
+// chunk: NNNNNNNN.chunk until the server has acked it, NNNNNNNN.acked after.
+// Acked chunks are kept so a commit that reports missing chunks can still be
+// answered; the directory is removed once the commit succeeds.
+// Every file is written to a .tmp, synced and renamed into place.
+class UploadStore
+{
+public:
+    explicit UploadStore(const std::string &root = UPLOAD_SPOOL_DIR);
+
+    std::string sessionDir(const std::string &sample_id, const std::string &start_unix) const;
+    std::vector<std::string> listSessions() const;
+
+    bool saveMeta(const std::string &dir, const UploadMeta &meta);
+    bool loadMeta(const std::string &dir, UploadMeta &meta) const;
+
+    bool writeChunk(const std::string &dir, int seq, const int32_t *channel, const int32_t *red, const int32_t *ir, size_t count,
+                    const uint8_t *quality, int channels);
+    bool readChunk(const std::string &dir, int seq, UploadChunk &chunk) const;
+    bool markAcked(const std::string &dir, int seq);
+
+    // Sequence numbers on disk, sorted; pending only or acked as well
+    std::vector<int> listChunks(const std::string &dir, bool includeAcked) const;
+
+    void removeSession(const std::string &dir);
+
+private:
+    std::string chunkPath(const std::string &dir, int seq, bool acked) const;
+
+    std::string root;
+};
+
+#endif // UPLOADSTORE_H
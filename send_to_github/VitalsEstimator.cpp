@@ -0,0 +1,130 @@
+#include "VitalsEstimator.h"
+#include "SignalPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+VitalsEstimator::VitalsEstimator()
+    : count(0), envelopeDecay(1), refractoryNs(0), calibration(SpO2Calibration::standard())
+{
+    memset(state, 0, sizeof(state));
+    memset(vitals, 0, sizeof(vitals));
+}
+
+void VitalsEstimator::configure(int channels, double sampleRate, const SpO2Calibration &cal)
+{
+    count = max(0, min(channels, DSP_MAX_CHANNELS));
+    calibration = cal;
+    // The envelope halves in two seconds, slow enough to bridge a missed beat
+    envelopeDecay = sampleRate > 0 ? static_cast<float>(pow(0.5, 1.0 / (2.0 * sampleRate))) : 1.0f;
+    refractoryNs = static_cast<int64_t>(60.0 / VITALS_MAX_BPM * 1e9);
+
+    memset(state, 0, sizeof(state));
+    memset(vitals, 0, sizeof(vitals));
+}
+
+void VitalsEstimator::process(const PipelineFrame &frame)
+{
+    int64_t now = frame.timestamp_ns;
+    for (int ch = 0; ch < count; ch++)
+    {
+        State &st = state[ch];
+        ChannelVitals &v = vitals[ch];
+        float ir = frame.irAc[ch];
+        float red = frame.redAc[ch];
+
+        st.irMin = min(st.irMin, ir);
+        st.irMax = max(st.irMax, ir);
+        st.redMin = min(st.redMin, red);
+        st.redMax = max(st.redMax, red);
+
+        // Systole is a dip in reflected light
+        float s = -ir;
+        bool usable = !(frame.quality[ch] & (QUALITY_NO_CONTACT | QUALITY_MOTION));
+        st.envelope = max(st.envelope * envelopeDecay, usable ? fabs(s) : 0.0f);
+
+        bool refractory = v.beats > 0 && now - v.lastBeatNs < refractoryNs;
+        if (!usable)
+        {
+            // Nothing to detect; the stale check below invalidates the channel
+            st.armed = false;
+        }
+        else if (!st.armed)
+        {
+            if (!refractory && s > 0.5f * st.envelope && st.envelope > 0)
+            {
+                st.armed = true;
+                st.candidate = s;
+                st.candidateNs = now;
+            }
+        }
+        else if (s > st.candidate)
+        {
+            st.candidate = s;
+            st.candidateNs = now;
+        }
+        else if (s < 0 || s < st.candidate - 0.5f * st.envelope)
+        {
+            // Past the top: the highest point since arming was the beat
+            st.armed = false;
+            beat(ch, st.candidateNs, frame);
+        }
+
+        if (v.valid && now - v.lastBeatNs > static_cast<int64_t>(VITALS_STALE_SECONDS * 1e9))
+        {
+            // Lost contact or a run of missed beats; start collecting intervals again
+            v.valid = false;
+            st.ibiCount = 0;
+        }
+    }
+}
+
+void VitalsEstimator::beat(int ch, int64_t beatNs, const PipelineFrame &frame)
+{
+    State &st = state[ch];
+    ChannelVitals &v = vitals[ch];
+
+    if (v.beats > 0)
+    {
+        float ibi = static_cast<float>((beatNs - v.lastBeatNs) / 1e9);
+        if (ibi >= 60.0f / VITALS_MAX_BPM && ibi <= 60.0f / VITALS_MIN_BPM)
+        {
+            st.ibi[st.ibiNext] = ibi;
+            st.ibiNext = (st.ibiNext + 1) % VITALS_IBI_HISTORY;
+            st.ibiCount = min(st.ibiCount + 1, VITALS_IBI_HISTORY);
+        }
+        else if (ibi > 60.0f / VITALS_MIN_BPM)
+        {
+            st.ibiCount = 0;
+        }
+    }
+
+    // Ratio of ratios from the swings since the previous beat
+    float irAmp = st.irMax - st.irMin;
+    float redAmp = st.redMax - st.redMin;
+    if (irAmp > 0 && redAmp > 0 && frame.irDc[ch] > 0 && frame.redDc[ch] > 0)
+    {
+        float r = (redAmp / frame.redDc[ch]) / (irAmp / frame.irDc[ch]);
+        v.ratio = v.ratio > 0 ? v.ratio + 0.25f * (r - v.ratio) : r;
+    }
+    st.irMin = st.irMax = frame.irAc[ch];
+    st.redMin = st.redMax = frame.redAc[ch];
+
+    v.beats++;
+    v.lastBeatNs = beatNs;
+
+    if (st.ibiCount >= 3 && v.ratio > 0)
+    {
+        float sorted[VITALS_IBI_HISTORY];
+        copy(st.ibi, st.ibi + st.ibiCount, sorted);
+        sort(sorted, sorted + st.ibiCount);
+        v.heartRate = 60.0f / sorted[st.ibiCount / 2];
+
+        double r = v.ratio;
+        double spo2 = calibration.a + calibration.b * r + calibration.c * r * r;
+        v.spo2 = static_cast<float>(max(0.0, min(100.0, spo2)));
+        v.valid = true;
+    }
+}
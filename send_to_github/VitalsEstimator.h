@@ -0,0 +1,74 @@
+#ifndef VITALSESTIMATOR_H
+#define VITALSESTIMATOR_H
+
+#include <stdint.h>
+#include "DspCommon.h"
+
+#define VITALS_MIN_BPM 30
+#define VITALS_MAX_BPM 220
+#define VITALS_IBI_HISTORY 5
+#define VITALS_STALE_SECONDS 3.0
+
+struct PipelineFrame;
+
+// SpO2 = a + b * R + c * R^2 with R the red/ir ratio of ratios.
+// The default is the usual linear approximation; a per-device fit can replace it.
+struct SpO2Calibration
+{
+    double a, b, c;
+
+    static SpO2Calibration standard() { return SpO2Calibration{110.0, -25.0, 0.0}; }
+};
+
+struct ChannelVitals
+{
+    bool valid;         // enough recent beats to trust the numbers below
+    float heartRate;    // beats per minute, median of the last intervals
+    float spo2;         // percent
+    float ratio;        // smoothed ratio of ratios
+    uint32_t beats;     // detected so far
+    int64_t lastBeatNs; // timestamp of the last detected beat
+};
+
+// Streaming heart rate and SpO2 per channel, O(1) work per sample.
+// Beats are the systolic peaks of the ir pulse band (blood volume up, reflected
+// light down, so the pulse is inverted). A decaying envelope sets the detection
+// threshold, a refractory time of one beat at VITALS_MAX_BPM rejects the
+// dicrotic wave. Between beats the red and ir swings are tracked; at each beat
+// their AC/DC ratio gives R, which is smoothed and mapped through the calibration.
+class VitalsEstimator
+{
+public:
+    VitalsEstimator();
+
+    void configure(int channels, double sampleRate, const SpO2Calibration &calibration = SpO2Calibration::standard());
+    void process(const PipelineFrame &frame);
+
+    int channels() const { return count; }
+    const ChannelVitals &channel(int ch) const { return vitals[ch]; }
+
+private:
+    struct State
+    {
+        float envelope;
+        float candidate;
+        int64_t candidateNs;
+        bool armed;
+        float irMin, irMax, redMin, redMax;
+        float ibi[VITALS_IBI_HISTORY];
+        int ibiCount;
+        int ibiNext;
+    };
+
+    void beat(int ch, int64_t beatNs, const PipelineFrame &frame);
+
+    int count;
+    float envelopeDecay;
+    int64_t refractoryNs;
+    SpO2Calibration calibration;
+
+    State state[DSP_MAX_CHANNELS];
+    ChannelVitals vitals[DSP_MAX_CHANNELS];
+};
+
+#endif // VITALSESTIMATOR_H
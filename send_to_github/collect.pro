@@ -15,6 +15,14 @@ LIBS += -L/lib/aarch64-linux-gnu -lcurl
 LIBS += -L/lib/aarch64-linux-gnu -lpaho-mqtt3c
 LIBS += -L/lib/aarch64-linux-gnu -lqrencode
 LIBS += -L/lib/aarch64-linux-gnu -lpng
+LIBS += -lrt
+LIBS += -lz
+
+# zstd request bodies: qmake CONFIG+=zstd
+zstd {
+    DEFINES += USE_ZSTD
+    LIBS += -lzstd
+}
 
 TARGET = collect
 TEMPLATE = app
@@ -27,7 +35,32 @@ SOURCES += main.cpp\
         MaxPlot.cpp \
         MQTTWorker.cpp\
         QRCodeGenerator.cpp \
-        MaxDataWorker.cpp
+        MaxDataWorker.cpp \
+        MqttSpool.cpp \
+        ShmRing.cpp \
+        SessionUploader.cpp \
+        JsonStreamWriter.cpp \
+        HttpClient.cpp \
+        CompressedBody.cpp \
+        UploadStore.cpp \
+        SessionBuffer.cpp \
+        RecordingFile.cpp \
+        SyncWriter.cpp \
+        ReplaySource.cpp \
+        FrameSource.cpp \
+        SyntheticSource.cpp \
+        ChannelFilter.cpp \
+        OutlierDetector.cpp \
+        ChannelAligner.cpp \
+        SignalPipeline.cpp \
+        VitalsEstimator.cpp \
+        PerfusionMonitor.cpp \
+        SignalQuality.cpp \
+        PulseTransit.cpp \
+        BeatFeatures.cpp \
+        BeatLog.cpp \
+        MotionDetector.cpp \
+        MultiRateDecimator.cpp
 
 HEADERS  += qcustomplot.h\
             mainwindow.h\
@@ -35,4 +68,48 @@ HEADERS  += qcustomplot.h\
             max30102.h \
             MQTTWorker.h \
             QRCodeGenerator.h \
-            MaxDataWorker.h
+            MaxDataWorker.h \
+            MqttSpool.h \
+            ShmRing.h \
+            SessionUploader.h \
+            JsonStreamWriter.h \
+            HttpClient.h \
+            CompressedBody.h \
+            UploadStore.h \
+            SessionBuffer.h \
+            RecordingFile.h \
+            SyncWriter.h \
+            FrameSource.h \
+            ReplaySource.h \
+            SyntheticSource.h \
+            DspCommon.h \
+            ChannelFilter.h \
+            OutlierDetector.h \
+            ChannelAligner.h \
+            SignalPipeline.h \
+            VitalsEstimator.h \
+            PerfusionMonitor.h \
+            SignalQuality.h \
+            PulseTransit.h \
+            BeatFeatures.h \
+            BeatLog.h \
+            MotionDetector.h \
+            MultiRateDecimator.h \
+            RealFft.h
+
+# Qt-free checks of the signal stages against reference output: make dspcheck
+# Each check runs twice, with the vector kernels and with DSP_SCALAR.
+DSPCHECK_DIR = $$OUT_PWD/build/check
+dspcheck.commands = \
+    mkdir -p $$DSPCHECK_DIR && \
+    $(CXX) -O2 -std=c++11 -I$$PWD -o $$DSPCHECK_DIR/filter_check \
+        $$PWD/examples/filter_check.cpp $$PWD/ChannelFilter.cpp && \
+    $(CXX) -O2 -std=c++11 -DDSP_SCALAR -I$$PWD -o $$DSPCHECK_DIR/filter_check_scalar \
+        $$PWD/examples/filter_check.cpp $$PWD/ChannelFilter.cpp && \
+    $(CXX) -O2 -std=c++11 -I$$PWD -o $$DSPCHECK_DIR/fft_check $$PWD/examples/fft_check.cpp && \
+    $(CXX) -O2 -std=c++11 -DDSP_SCALAR -I$$PWD -o $$DSPCHECK_DIR/fft_check_scalar $$PWD/examples/fft_check.cpp && \
+    $$DSPCHECK_DIR/filter_check $$PWD/examples/filter_golden.txt && \
+    $$DSPCHECK_DIR/filter_check_scalar $$PWD/examples/filter_golden.txt && \
+    $$DSPCHECK_DIR/fft_check && \
+    $$DSPCHECK_DIR/fft_check_scalar
+QMAKE_EXTRA_TARGETS += dspcheck
@@ -0,0 +1,100 @@
+// Runs the filter bank, the vitals estimator and the spectral quality stage on
+// a synthetic session and checks the vitals and the spectral heart rate
+// against what the generator was set to; exits non-zero when one is missed.
+// Build: moc ../FrameSource.h -o moc_FrameSource.cpp && moc ../SyntheticSource.h -o moc_SyntheticSource.cpp &&
+//        g++ -O2 -std=c++11 -fPIC -I.. -o dsp_check dsp_check.cpp ../SyntheticSource.cpp ../FrameSource.cpp
+//        ../ChannelFilter.cpp ../VitalsEstimator.cpp ../SignalQuality.cpp moc_FrameSource.cpp moc_SyntheticSource.cpp
+//        $(pkg-config --cflags --libs Qt5Core)
+
+#include "SyntheticSource.h"
+#include "SignalPipeline.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+#define CHECK_CHANNELS 8
+#define CHECK_SECONDS 60
+
+#define CHECK_HR_TOLERANCE 3.0   // beats per minute
+#define CHECK_SPO2_TOLERANCE 3.0 // percent
+#define CHECK_SPECTRAL_TOLERANCE 3.0 // beats per minute, the peak is interpolated between bins
+
+static int failures = 0;
+
+static void expect(bool ok, const string &what)
+{
+    cout << (ok ? "ok      " : "FAILED  ") << what << endl;
+    if (!ok)
+        failures++;
+}
+
+static void checkRate(uint32_t rate)
+{
+    cout << "-- " << rate << " Hz" << endl;
+
+    // Clean channels; motion and lift-offs are what the quality stages are for
+    SyntheticConfig config = SyntheticConfig::standard(CHECK_CHANNELS, rate);
+    config.seconds = CHECK_SECONDS;
+    config.speed = 0;
+    for (int i = 0; i < CHECK_CHANNELS; i++)
+    {
+        config.channel[i].motionPerMinute = 0;
+        config.channel[i].dropoutPerMinute = 0;
+    }
+
+    ChannelFilterBank red, ir;
+    VitalsEstimator vitals;
+    unique_ptr<SignalQuality> quality(new SignalQuality()); // too big for the stack
+
+    expect(red.setup(CHECK_CHANNELS, rate) && ir.setup(CHECK_CHANNELS, rate), "filter setup");
+    vitals.configure(CHECK_CHANNELS, rate);
+    quality->configure(CHECK_CHANNELS, rate);
+
+    PipelineFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.channels = CHECK_CHANNELS;
+
+    SyntheticSource source(config);
+    QObject::connect(&source, &FrameSource::dataReady, [&](const MaxDataRef &data)
+    {
+        frame.timestamp_ns = data->timestamp_ns;
+        red.process(data->redData, frame.redAc, frame.redDc);
+        ir.process(data->irData, frame.irAc, frame.irDc);
+        vitals.process(frame);
+        quality->process(frame);
+        source.frameHandled();
+    });
+    source.run();
+
+    expect(quality->spectrumReady(), "spectrum ready");
+    for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+    {
+        const SyntheticChannel &want = config.channel[ch];
+        const ChannelVitals &got = vitals.channel(ch);
+        string name = "channel " + to_string(ch) + ": ";
+        expect(got.valid, name + "vitals valid");
+        expect(fabs(got.heartRate - want.heartRate) <= CHECK_HR_TOLERANCE,
+               name + "heart rate " + to_string(got.heartRate) + ", set to " + to_string(want.heartRate));
+        expect(fabs(got.spo2 - want.spo2) <= CHECK_SPO2_TOLERANCE,
+               name + "SpO2 " + to_string(got.spo2) + ", set to " + to_string(want.spo2));
+        expect(fabs(quality->spectralRate(ch) - want.heartRate) <= CHECK_SPECTRAL_TOLERANCE,
+               name + "spectral heart rate " + to_string(quality->spectralRate(ch)) + ", set to " + to_string(want.heartRate));
+        expect(quality->level(ch) == SIGNAL_GOOD, name + "signal level good");
+    }
+}
+
+int main()
+{
+    cout << "Filter kernel: " << ChannelFilterBank::kernelName() << endl;
+    checkRate(100);
+    checkRate(400);
+
+    if (failures)
+        cout << failures << " checks failed" << endl;
+    else
+        cout << "All checks passed" << endl;
+    return failures ? 1 : 0;
+}
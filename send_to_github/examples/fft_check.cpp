@@ -0,0 +1,185 @@
+// Checks RealFft against a direct DFT in double precision for every size from
+// 4 to 1024, then times the spectrum size SignalQuality uses against a naive
+// single precision DFT of the same channels. Exits non-zero when a spectrum is
+// off or the transform misses its time budget.
+// Build: g++ -O2 -std=c++11 -I.. -o fft_check fft_check.cpp
+//        g++ -O2 -std=c++11 -DDSP_SCALAR -I.. -o fft_check_scalar fft_check.cpp
+
+#include "RealFft.h"
+#include "SignalQuality.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHECK_CHANNELS 5 // one vector block and a scalar tail
+#define CHECK_TOLERANCE 1e-5 // of the largest bin, single precision over log2(N) stages
+
+#define BENCH_CHANNELS 8
+#define BENCH_SIZE SQI_SPECTRUM_SIZE
+#define BENCH_ROUNDS 200
+#define BENCH_CPU_BUDGET 0.05 // share of one core for one spectrum a second
+
+static int failures = 0;
+
+static void expect(bool ok, const string &what)
+{
+    printf("%s%s\n", ok ? "ok      " : "FAILED  ", what.c_str());
+    if (!ok)
+        failures++;
+}
+
+// Time-major test signal: noise from a fixed generator plus a tone and a DC
+// offset that differ per channel
+static void makeSignal(int n, int channels, vector<float> &x)
+{
+    uint32_t seed = 2024;
+    x.assign(static_cast<size_t>(n) * DSP_MAX_CHANNELS, 0.0f);
+    for (int i = 0; i < n; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            double noise = ((seed >> 8) & 0xffff) / 32768.0 - 1;
+            double tone = 3 * cos(2 * M_PI * (c + 1) * i / n + c);
+            x[static_cast<size_t>(i) * DSP_MAX_CHANNELS + c] = static_cast<float>(c - 2 + tone + noise);
+        }
+    }
+}
+
+template <int N>
+static void checkSize()
+{
+    const int bins = RealFft<N>::Bins;
+    unique_ptr<RealFft<N> > fft(new RealFft<N>());
+    vector<float> x, re(bins * DSP_MAX_CHANNELS), im(bins * DSP_MAX_CHANNELS), power(bins * DSP_MAX_CHANNELS);
+    makeSignal(N, CHECK_CHANNELS, x);
+
+    fft->transform(x.data(), CHECK_CHANNELS, re.data(), im.data());
+    fft->power(x.data(), CHECK_CHANNELS, power.data());
+
+    double worst = 0, worstPower = 0;
+    for (int c = 0; c < CHECK_CHANNELS; c++)
+    {
+        vector<double> wantRe(bins), wantIm(bins);
+        double peak = 0;
+        for (int k = 0; k < bins; k++)
+        {
+            double sr = 0, si = 0;
+            for (int i = 0; i < N; i++)
+            {
+                double v = x[static_cast<size_t>(i) * DSP_MAX_CHANNELS + c];
+                sr += v * cos(2 * M_PI * k * i / N);
+                si -= v * sin(2 * M_PI * k * i / N);
+            }
+            wantRe[k] = sr;
+            wantIm[k] = si;
+            peak = max(peak, hypot(sr, si));
+        }
+
+        for (int k = 0; k < bins; k++)
+        {
+            double gotRe = re[k * DSP_MAX_CHANNELS + c], gotIm = im[k * DSP_MAX_CHANNELS + c];
+            double gotPower = power[k * DSP_MAX_CHANNELS + c];
+            worst = max(worst, hypot(gotRe - wantRe[k], gotIm - wantIm[k]) / peak);
+            worstPower = max(worstPower, fabs(gotPower - (wantRe[k] * wantRe[k] + wantIm[k] * wantIm[k])) / (peak * peak));
+        }
+    }
+
+    char what[96];
+    snprintf(what, sizeof(what), "N = %d: largest error %.2g of the peak, power %.2g", N, worst, worstPower);
+    expect(worst <= CHECK_TOLERANCE && worstPower <= 2 * CHECK_TOLERANCE, what);
+}
+
+// What the spectrum stage would cost without the FFT: every bin a full pass
+// over the window, with the same tables and layout
+static void naiveDft(const float *x, int n, int channels, const float *cosTable, const float *sinTable, float *out)
+{
+    for (int k = 0; k <= n / 2; k++)
+    {
+        float sr[DSP_MAX_CHANNELS] = { 0 }, si[DSP_MAX_CHANNELS] = { 0 };
+        for (int i = 0; i < n; i++)
+        {
+            int t = (k * i) % n;
+            const float *row = x + static_cast<size_t>(i) * DSP_MAX_CHANNELS;
+            for (int c = 0; c < channels; c++)
+            {
+                sr[c] += row[c] * cosTable[t];
+                si[c] -= row[c] * sinTable[t];
+            }
+        }
+        for (int c = 0; c < channels; c++)
+            out[k * DSP_MAX_CHANNELS + c] = sr[c] * sr[c] + si[c] * si[c];
+    }
+}
+
+static void benchmark()
+{
+    const int bins = RealFft<BENCH_SIZE>::Bins;
+    unique_ptr<RealFft<BENCH_SIZE> > fft(new RealFft<BENCH_SIZE>());
+    vector<float> x, fftOut(bins * DSP_MAX_CHANNELS), dftOut(bins * DSP_MAX_CHANNELS);
+    makeSignal(BENCH_SIZE, BENCH_CHANNELS, x);
+
+    vector<float> cosTable(BENCH_SIZE), sinTable(BENCH_SIZE);
+    for (int i = 0; i < BENCH_SIZE; i++)
+    {
+        cosTable[i] = static_cast<float>(cos(2 * M_PI * i / BENCH_SIZE));
+        sinTable[i] = static_cast<float>(sin(2 * M_PI * i / BENCH_SIZE));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+        fft->power(x.data(), BENCH_CHANNELS, fftOut.data());
+    double fftSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / BENCH_ROUNDS;
+
+    start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+        naiveDft(x.data(), BENCH_SIZE, BENCH_CHANNELS, cosTable.data(), sinTable.data(), dftOut.data());
+    double dftSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count() / BENCH_ROUNDS;
+
+    // Both outputs are used, so neither loop can be dropped
+    double worst = 0, peak = 0;
+    for (int i = 0; i < bins * DSP_MAX_CHANNELS; i++)
+    {
+        worst = max(worst, static_cast<double>(fabs(fftOut[i] - dftOut[i])));
+        peak = max(peak, static_cast<double>(dftOut[i]));
+    }
+    expect(worst <= 1e-3 * peak, "FFT and naive DFT agree");
+
+    char what[160];
+    snprintf(what, sizeof(what), "N = %d, %d channels: FFT %.1f us, naive DFT %.1f us (%.0fx), %.4f%% of one core at one spectrum a second",
+             BENCH_SIZE, BENCH_CHANNELS, fftSeconds * 1e6, dftSeconds * 1e6, dftSeconds / fftSeconds, fftSeconds * 100);
+    expect(fftSeconds <= BENCH_CPU_BUDGET && fftSeconds < dftSeconds, what);
+}
+
+int main()
+{
+#if defined(DSP_NEON)
+    printf("Kernel: neon\n");
+#elif defined(DSP_SSE2)
+    printf("Kernel: sse2\n");
+#else
+    printf("Kernel: scalar\n");
+#endif
+
+    checkSize<4>();
+    checkSize<8>();
+    checkSize<16>();
+    checkSize<32>();
+    checkSize<64>();
+    checkSize<128>();
+    checkSize<256>();
+    checkSize<512>();
+    checkSize<1024>();
+    benchmark();
+
+    if (failures)
+        printf("%d checks failed\n", failures);
+    else
+        printf("All checks passed\n");
+    return failures ? 1 : 0;
+}
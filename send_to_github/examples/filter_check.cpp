@@ -0,0 +1,228 @@
+// Feeds a fixed synthetic recording through ChannelFilterBank and compares the
+// AC and DC outputs against the reference vectors in filter_golden.txt, then
+// times the bank at 8 channels and 1 kHz. Build it once as is and once with
+// -DDSP_SCALAR: both kernels have to reproduce the same reference vectors.
+// Exits non-zero when an output or the time budget is missed.
+// Build: g++ -O2 -std=c++11 -I.. -o filter_check filter_check.cpp ../ChannelFilter.cpp
+//        g++ -O2 -std=c++11 -DDSP_SCALAR -I.. -o filter_check_scalar filter_check.cpp ../ChannelFilter.cpp
+// Run:   ./filter_check filter_golden.txt
+// The reference vectors come from the scalar build: ./filter_check_scalar --write filter_golden.txt
+
+#include "ChannelFilter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define CHECK_CHANNELS 11 // two vector blocks and a scalar tail
+#define CHECK_RATE 100
+#define CHECK_FRAMES 3000
+#define CHECK_EVERY 25 // frames between reference rows
+
+// Float rounding differs between kernels and compilers (operation order, fused
+// multiply-adds) by a few ulp of the DC level, which reaches the AC output too.
+// Both are compared with a margin scaled by the level, well below one count.
+#define CHECK_TOLERANCE 2e-6
+
+#define BENCH_CHANNELS 8
+#define BENCH_RATE 1000
+#define BENCH_SECONDS 60
+#define BENCH_CPU_BUDGET 0.10 // share of one core
+
+// Raw counts of one frame: a DC level per channel with a pulse on top, a step
+// in the baseline part way through and a little noise from a fixed generator
+static void makeFrame(int frame, int channels, double rate, uint32_t *out)
+{
+    static uint32_t seed = 12345;
+    if (frame == 0)
+        seed = 12345;
+
+    double t = frame / rate;
+    for (int ch = 0; ch < channels; ch++)
+    {
+        double level = 60000 + 7000 * ch;
+        if (ch % 3 == 1 && t >= 10)
+            level *= 1.05;
+        double hr = (60 + 7 * ch) / 60.0;
+        double pulse = sin(2 * M_PI * hr * t) + 0.3 * sin(4 * M_PI * hr * t + 0.5);
+
+        seed = seed * 1103515245u + 12345u;
+        int noise = static_cast<int>((seed >> 16) % 41) - 20;
+        out[ch] = static_cast<uint32_t>(lround(level * (1 + 0.015 * pulse)) + noise);
+    }
+}
+
+// One reference row: the frame number, then AC and DC for every channel
+struct Row
+{
+    int frame;
+    vector<float> ac, dc;
+};
+
+static vector<Row> runFilter()
+{
+    ChannelFilterBank bank;
+    vector<Row> rows;
+    if (!bank.setup(CHECK_CHANNELS, CHECK_RATE))
+        return rows;
+
+    uint32_t in[CHECK_CHANNELS];
+    float ac[CHECK_CHANNELS], dc[CHECK_CHANNELS];
+    for (int frame = 0; frame < CHECK_FRAMES; frame++)
+    {
+        makeFrame(frame, CHECK_CHANNELS, CHECK_RATE, in);
+        bank.process(in, ac, dc);
+        if (frame % CHECK_EVERY == CHECK_EVERY - 1)
+        {
+            Row row;
+            row.frame = frame;
+            row.ac.assign(ac, ac + CHECK_CHANNELS);
+            row.dc.assign(dc, dc + CHECK_CHANNELS);
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+static bool writeGolden(const char *path, const vector<Row> &rows)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "# ChannelFilterBank reference output, written by filter_check --write (%s kernel)\n",
+            ChannelFilterBank::kernelName());
+    fprintf(file, "# %d channels at %d Hz; frame, then AC and DC per channel\n", CHECK_CHANNELS, CHECK_RATE);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        fprintf(file, "%d", rows[i].frame);
+        for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+            fprintf(file, " %.9g", rows[i].ac[ch]);
+        for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+            fprintf(file, " %.9g", rows[i].dc[ch]);
+        fprintf(file, "\n");
+    }
+    return fclose(file) == 0;
+}
+
+static bool readGolden(const char *path, vector<Row> &rows)
+{
+    ifstream file(path);
+    if (!file)
+    {
+        cerr << "Cannot open " << path << endl;
+        return false;
+    }
+
+    string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        Row row;
+        row.ac.resize(CHECK_CHANNELS);
+        row.dc.resize(CHECK_CHANNELS);
+        fields >> row.frame;
+        for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+            fields >> row.ac[ch];
+        for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+            fields >> row.dc[ch];
+        if (!fields)
+        {
+            cerr << "Malformed reference row in " << path << ": " << line << endl;
+            return false;
+        }
+        rows.push_back(row);
+    }
+    return true;
+}
+
+static int compare(const vector<Row> &got, const vector<Row> &want)
+{
+    if (got.size() != want.size())
+    {
+        cout << "FAILED  " << got.size() << " rows, the reference has " << want.size() << endl;
+        return 1;
+    }
+
+    int failures = 0;
+    double worst = 0;
+    for (size_t i = 0; i < got.size(); i++)
+    {
+        for (int ch = 0; ch < CHECK_CHANNELS; ch++)
+        {
+            double margin = CHECK_TOLERANCE * want[i].dc[ch];
+            double error = max(fabs(got[i].ac[ch] - want[i].ac[ch]), fabs(got[i].dc[ch] - want[i].dc[ch]));
+            worst = max(worst, error);
+            if (error <= margin)
+                continue;
+            if (failures++ < 10)
+                cout << "FAILED  frame " << got[i].frame << " channel " << ch
+                     << ": AC " << got[i].ac[ch] << " (want " << want[i].ac[ch] << ")"
+                     << ", DC " << got[i].dc[ch] << " (want " << want[i].dc[ch] << ")" << endl;
+        }
+    }
+    cout << (failures ? "FAILED  " : "ok      ") << "reference output, largest difference " << worst << endl;
+    return failures ? 1 : 0;
+}
+
+static int benchmark()
+{
+    ChannelFilterBank bank;
+    bank.setup(BENCH_CHANNELS, BENCH_RATE);
+
+    const int frames = BENCH_RATE * BENCH_SECONDS;
+    vector<uint32_t> in(static_cast<size_t>(frames) * BENCH_CHANNELS);
+    for (int frame = 0; frame < frames; frame++)
+        makeFrame(frame, BENCH_CHANNELS, BENCH_RATE, &in[static_cast<size_t>(frame) * BENCH_CHANNELS]);
+
+    float ac[BENCH_CHANNELS], dc[BENCH_CHANNELS];
+    float sink = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        bank.process(&in[static_cast<size_t>(frame) * BENCH_CHANNELS], ac, dc);
+        sink += ac[0];
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double load = seconds / BENCH_SECONDS;
+    bool ok = load <= BENCH_CPU_BUDGET && !std::isnan(sink);
+    printf("%s%d channels at %d Hz: %.0f ns per frame, %.3f%% of one core\n", ok ? "ok      " : "FAILED  ",
+           BENCH_CHANNELS, BENCH_RATE, seconds * 1e9 / frames, load * 100);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "--write") == 0)
+        return writeGolden(argv[2], runFilter()) ? 0 : 1;
+    if (argc != 2)
+    {
+        cerr << "Usage: " << argv[0] << " filter_golden.txt | --write filter_golden.txt" << endl;
+        return 2;
+    }
+
+    vector<Row> want;
+    if (!readGolden(argv[1], want))
+        return 1;
+
+    cout << "Filter kernel: " << ChannelFilterBank::kernelName() << endl;
+    int failures = compare(runFilter(), want) + benchmark();
+
+    if (failures)
+        cout << failures << " checks failed" << endl;
+    else
+        cout << "All checks passed" << endl;
+    return failures ? 1 : 0;
+}
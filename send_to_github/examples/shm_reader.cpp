@@ -0,0 +1,73 @@
+// Follows the live frame ring exported by collect and prints one line per frame.
+// Build: g++ -O2 -std=c++11 -I.. -o shm_reader shm_reader.cpp ../ShmRing.cpp -lrt
+
+#include "ShmRing.h"
+#include <iostream>
+#include <unistd.h>
+
+using namespace std;
+
+static void attach(ShmRingReader &ring, const char *name)
+{
+    while (!ring.open(name))
+    {
+        cout << "Waiting for collect to create " << name << endl;
+        sleep(1);
+    }
+    cout << "Attached: " << ring.channels() << " channels at " << ring.sampleRate() << " Hz" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *name = argc > 1 ? argv[1] : SHM_RING_NAME;
+
+    ShmRingReader ring;
+    attach(ring, name);
+
+    uint64_t next = ring.head();
+    uint64_t lost = 0;
+    ShmFrame frame;
+
+    while (true)
+    {
+        uint64_t head = ring.head();
+        if (next == head)
+        {
+            // collect restarted or exited: follow the new ring from its start
+            if (ring.retired())
+            {
+                cout << "Ring replaced, reattaching" << endl;
+                ring.close();
+                attach(ring, name);
+                next = 0;
+                lost = 0;
+                continue;
+            }
+            usleep(1000);
+            continue;
+        }
+
+        if (next < ring.oldest())
+        {
+            lost += ring.oldest() - next;
+            next = ring.oldest();
+        }
+
+        if (!ring.read(next, frame))
+        {
+            // Overwritten while copying: we are too slow, jump forward
+            lost++;
+            next++;
+            continue;
+        }
+
+        cout << frame.seq << " " << frame.timestamp_ns;
+        for (int i = 0; i < frame.channels; i++)
+            cout << " " << frame.red[i] << "/" << frame.ir[i];
+        if (lost)
+            cout << " (lost " << lost << ")";
+        cout << endl;
+        next++;
+    }
+    return 0;
+}
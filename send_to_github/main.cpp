@@ -1,16 +1,34 @@
 // main.cpp
 
 #include "mainwindow.h"
+#include "HttpClient.h"
+#include "SessionUploader.h"
 
 #include <QApplication>
+#include <curl/curl.h>
 
 int main(int argc, char *argv[])
 {
     QApplication app(argc, argv);
 
-    MainWindow window;
-    window.resize(300, 150);
-    window.show();
+    // Once per process, before any thread touches curl
+    curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    return app.exec();
+    // Resumes whatever an earlier run left in the upload spool
+    SessionUploader::instance();
+
+    int ret;
+    {
+        MainWindow window;
+        window.resize(300, 150);
+        window.show();
+
+        ret = app.exec();
+    }
+
+    // Let queued uploads finish on the shared connection before curl goes away
+    SessionUploader::instance().shutdown();
+    HttpClient::instance().shutdown();
+    curl_global_cleanup();
+    return ret;
 }
@@ -19,10 +19,22 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <chrono>
+#include <ctime>
+#include <signal.h>
+
+static void timer_handler(int sig, siginfo_t *si, void *uc)
+{
+    (void)sig;
+    (void)uc;
+    MAX30102 *sensor = (MAX30102 *)si->si_value.sival_ptr;
+    sensor->get_data();
+}
 
 MAX30102::MAX30102(const char *device, uint8_t tcaAddress, uint8_t maxAddress)
     : device(device), tcaAddress(tcaAddress), maxAddress(maxAddress)
 {
+    memset(&data, 0, sizeof(data));
+    data.channels = MAX30102_CHANNELS;
     fd = init_i2c(device, TCA9548A_ADDR);
     scanf_channel();
     init_channel_sensor();
@@ -62,12 +74,12 @@ void MAX30102::max30102_init(int max_fd)
     writeRegister(max_fd, REG_INTR_ENABLE_1, 0xE0);
 
     writeRegister(max_fd, REG_INTR_ENABLE_2, 0x00);
-    writeRegister(max_fd, REG_FIFO_CONFIG, 0x0F);
-    writeRegister(max_fd, REG_MODE_CONFIG, 0x03);
-    writeRegister(max_fd, REG_SPO2_CONFIG, 0x27);
-    writeRegister(max_fd, REG_RED_LED, 0x24);
-    writeRegister(max_fd, REG_IR_LED, 0x24);
-    writeRegister(max_fd, REG_PILOT_PA, 0x7F);
+    writeRegister(max_fd, REG_FIFO_CONFIG, MAX30102_FIFO_CONFIG);
+    writeRegister(max_fd, REG_MODE_CONFIG, MAX30102_MODE_CONFIG);
+    writeRegister(max_fd, REG_SPO2_CONFIG, MAX30102_SPO2_CONFIG);
+    writeRegister(max_fd, REG_RED_LED, MAX30102_LED_PA);
+    writeRegister(max_fd, REG_IR_LED, MAX30102_LED_PA);
+    writeRegister(max_fd, REG_PILOT_PA, MAX30102_PILOT_PA);
 }
 
 void MAX30102::scanf_channel()
@@ -159,6 +171,8 @@ int MAX30102::init_i2c(const char *device, int addr)
 void MAX30102::get_data()
 {
     uint32_t red_temp, ir_temp;
+    int64_t read_ns[FRAME_MAX_CHANNELS] = {0};
+    struct timespec now;
 
     for (int i = 0; i < count_channel; i++)
     {
@@ -177,12 +191,79 @@ void MAX30102::get_data()
         read_fifo(&red_temp, &ir_temp, max30102_fd);
         // printf("channel %d - RED : %d - IR : %d \n", enable_channels[i], red_temp, ir_temp);
 
+        // The mux is walked one channel at a time, so every channel has its own read time
+        clock_gettime(CLOCK_REALTIME, &now);
+        read_ns[i] = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+
         data.channel_id[i] = i;
         data.redData[i] = red_temp;
         data.irData[i] = ir_temp;
 
         close(max30102_fd);
+    }
 
-        emit dataReady(data);
+    // One frame per pass over the channels, stamped with the first successful read
+    clock_gettime(CLOCK_REALTIME, &now);
+    data.timestamp_ns = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    for (int i = count_channel - 1; i >= 0; i--)
+    {
+        if (read_ns[i])
+            data.timestamp_ns = read_ns[i];
     }
+    // A channel that failed keeps its previous value and no offset
+    for (int i = 0; i < count_channel; i++)
+        data.offset_ns[i] = read_ns[i] ? static_cast<int32_t>(read_ns[i] - data.timestamp_ns) : 0;
+    emitFrame(data);
+}
+
+RecordingProfile MAX30102::profile() const
+{
+    RecordingProfile profile;
+    profile.sensor = "MAX30102";
+    profile.sample_rate = MAX30102_SAMPLE_RATE_HZ;
+    profile.channels = MAX30102_CHANNELS;
+    profile.mode_config = MAX30102_MODE_CONFIG;
+    profile.spo2_config = MAX30102_SPO2_CONFIG;
+    profile.fifo_config = MAX30102_FIFO_CONFIG;
+    profile.red_led = MAX30102_LED_PA;
+    profile.ir_led = MAX30102_LED_PA;
+    profile.pilot_pa = MAX30102_PILOT_PA;
+    return profile;
+}
+
+void MAX30102::run()
+{
+    struct sigevent sev;
+    struct sigaction sa;
+
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = timer_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGRTMIN, &sa, NULL);
+
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = SIGRTMIN;
+    sev.sigev_value.sival_ptr = this;
+
+    timer_t timerid;
+    if (timer_create(CLOCK_REALTIME, &sev, &timerid) == -1)
+    {
+        perror("timer_create");
+        return;
+    }
+
+    struct itimerspec its;
+    its.it_value.tv_sec = 0;
+    its.it_value.tv_nsec = 1000000000 / MAX30102_SAMPLE_RATE_HZ;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = 1000000000 / MAX30102_SAMPLE_RATE_HZ;
+
+    if (timer_settime(timerid, 0, &its, NULL) == -1)
+    {
+        perror("timer_settime");
+    }
+
+    sleep(5);
+
+    timer_delete(timerid);
 }
@@ -13,6 +13,7 @@
 #include <QDebug>
 #include <QObject>
 #include <QThread>
+#include "FrameSource.h"
 
 using namespace std;
 
@@ -38,14 +39,16 @@ using namespace std;
 #define REG_MULTI_LED_CTRL1 0x11
 #define REG_MULTI_LED_CTRL2 0x12
 
-struct MaxData
-{
-    uint32_t redData[8], irData[8], channel_id[8];
-};
-
-Q_DECLARE_METATYPE(MaxData)
+// 采集配置 (SpO2 mode, 100 Hz, 411 us / 18 bit, 4096 nA range)
+#define MAX30102_MODE_CONFIG 0x03
+#define MAX30102_FIFO_CONFIG 0x0F
+#define MAX30102_SPO2_CONFIG 0x27
+#define MAX30102_LED_PA 0x24
+#define MAX30102_PILOT_PA 0x7F
+#define MAX30102_SAMPLE_RATE_HZ 100
+#define MAX30102_CHANNELS 8
 
-class MAX30102 : public QObject
+class MAX30102 : public FrameSource
 {
     Q_OBJECT
 public:
@@ -73,12 +76,14 @@ public:
 
     void get_data();
 
-    void Quit();
+    RecordingProfile profile() const override;
 
-    MaxData data;
+    // Reads every channel each 10 ms for one 5 s session
+    void run() override;
+
+    void Quit() override;
 
-signals:
-    void dataReady(const MaxData &data);
+    MaxData data;
 
 private:
     const char *device;